@@ -0,0 +1,233 @@
+// This file is distributed under the Revised BSD Open Source License.
+// See LICENSE.TXT for details.
+
+// microbenchmark for the cells of the instruction table: lambda columns building Html nodes vs BuiltinColumns
+
+#include <llvm/ADT/SmallString.h>
+#include <llvm/ADT/StringRef.h>
+#include <llvm/IR/BasicBlock.h>
+#include <llvm/IR/Function.h>
+#include <llvm/IR/IRBuilder.h>
+#include <llvm/IR/LLVMContext.h>
+#include <llvm/IR/Module.h>
+#include <llvm/IR/ModuleSlotTracker.h>
+#include <llvm/Support/Format.h>
+#include <llvm/Support/raw_ostream.h>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+#include "HtmlUtils.hpp"
+#include "ValueNameMangler.hpp"
+
+using namespace llvm;
+using namespace html;
+
+/// Builds a function with @p num_blocks blocks of 10 instructions each,
+/// a mix of the loads, arithmetic, calls & vector types real code has.
+static Function* makeFunction(Module& module, unsigned num_blocks) {
+  LLVMContext& ctx = module.getContext();
+
+  Type* i32     = Type::getInt32Ty(ctx);
+  Type* v4      = VectorType::get(i32, 4);
+  Type* void_ty = Type::getVoidTy(ctx);
+
+  auto callee = Function::Create(FunctionType::get(i32, {i32, i32}, false), Function::ExternalLinkage, "callee", &module);
+  auto fn     = Function::Create(FunctionType::get(void_ty, {Type::getInt32PtrTy(ctx), i32}, false),
+                                 Function::ExternalLinkage, "bench", &module);
+
+  auto arg = fn->arg_begin();
+  Value* ptr = &*arg++;
+  Value* n   = &*arg;
+  ptr->setName("p");
+  n->setName("n");
+
+  IRBuilder<> builder{BasicBlock::Create(ctx, "entry", fn)};
+
+  Value* prev = n;
+  for (unsigned idx = 0; idx < num_blocks; idx++) {
+    auto next = BasicBlock::Create(ctx, "bb", fn);
+
+    Value* a = builder.CreateLoad(i32, builder.CreateGEP(i32, ptr, prev, "addr"), "a");
+    Value* b = builder.CreateAdd(a, prev, "b");
+    Value* c = builder.CreateMul(b, builder.getInt32(3), "c");
+    Value* d = builder.CreateICmpSLT(c, n, "d");
+    Value* e = builder.CreateSelect(d, c, b, "e");
+    builder.CreateStore(e, builder.CreateGEP(i32, ptr, e, "slot"));
+    builder.CreateInsertElement(UndefValue::get(v4), e, builder.getInt32(0), "v");
+    prev = builder.CreateCall(callee, {e, c}, "h");
+    builder.CreateBr(next);
+
+    builder.SetInsertPoint(next);
+  }
+  builder.CreateRetVoid();
+
+  return fn;
+}
+
+/// Same as Renderer::CellBuffer in main.cpp
+struct CellBuffer {
+  CellBuffer() : _OS{_text} {}
+
+  raw_ostream& out() { return _OS; }
+  void endCell() { _ends.push_back(_text.size()); }
+
+  void clear() {
+    _text.clear();
+    _ends.clear();
+  }
+private:
+  SmallString<4096>   _text;
+  raw_svector_ostream _OS;
+  std::vector<size_t> _ends;
+};
+
+/// Renders one column, like Renderer::AttributeRenderer in main.cpp
+struct Column {
+  virtual ~Column() {}
+  virtual void renderBlock(const BasicBlock& bb, CellBuffer& cells) = 0;
+};
+
+/// Like LambdaRenderer: every cell is built as Html nodes by a std::function & then printed
+struct LambdaColumn final : Column {
+  explicit LambdaColumn(std::function<Html*(const Instruction&)> render) : _render{std::move(render)} {}
+
+  void renderBlock(const BasicBlock& bb, CellBuffer& cells) override {
+    for (auto& inst : bb) {
+      _render(inst)->print(cells.out());
+      cells.endCell();
+    }
+  }
+private:
+  std::function<Html*(const Instruction&)> _render;
+};
+
+/// Like the renderers BuiltinColumns creates: every cell is printed directly, the printing is inlined
+template<typename PrintCell>
+struct TextColumn final : Column {
+  explicit TextColumn(PrintCell printCell) : _printCell{std::move(printCell)} {}
+
+  void renderBlock(const BasicBlock& bb, CellBuffer& cells) override {
+    for (auto& inst : bb) {
+      _printCell(inst, cells.out());
+      cells.endCell();
+    }
+  }
+private:
+  PrintCell _printCell;
+};
+
+template<typename PrintCell>
+static std::unique_ptr<Column> textColumn(PrintCell printCell) {
+  return std::unique_ptr<Column>{new TextColumn<PrintCell>{std::move(printCell)}};
+}
+
+/// The name, type, opcode & operands columns the way LambdaRenderer rendered them
+static std::vector<std::unique_ptr<Column>> lambdaColumns(ValueNameMangler& names) {
+  std::vector<std::unique_ptr<Column>> columns;
+
+  columns.emplace_back(new LambdaColumn{[&names](const Instruction& inst) {
+    return html::str(inst.getType()->isVoidTy() ? StringRef{} : names.asOperand(inst));
+  }});
+  columns.emplace_back(new LambdaColumn{[&names](const Instruction& inst) {
+    return html::str(names.types().name(inst.getType()));
+  }});
+  columns.emplace_back(new LambdaColumn{[](const Instruction& inst) {
+    return html::str(inst.getOpcodeName());
+  }});
+  columns.emplace_back(new LambdaColumn{[&names](const Instruction& inst) {
+    auto wrapper = div();
+    for (auto op : const_cast<Instruction&>(inst).operand_values())
+      wrapper->add(names.ref(op), br());
+    return wrapper;
+  }});
+
+  return columns;
+}
+
+/// The same columns the way NameColumn, TypeColumn, OpcodeColumn & OperandsColumn print them
+static std::vector<std::unique_ptr<Column>> builtinColumns(ValueNameMangler& names) {
+  std::vector<std::unique_ptr<Column>> columns;
+
+  columns.push_back(textColumn([&names](const Instruction& inst, raw_ostream& OS) {
+    if (!inst.getType()->isVoidTy())
+      print_str(OS, names.asOperand(inst));
+  }));
+  columns.push_back(textColumn([&names](const Instruction& inst, raw_ostream& OS) {
+    print_str(OS, names.types().name(inst.getType()));
+  }));
+  columns.push_back(textColumn([](const Instruction& inst, raw_ostream& OS) {
+    OS << inst.getOpcodeName();
+  }));
+  columns.push_back(textColumn([&names](const Instruction& inst, raw_ostream& OS) {
+    for (auto op : const_cast<Instruction&>(inst).operand_values()) {
+      names.printRef(op, OS);
+      OS << "<br>";
+    }
+  }));
+
+  return columns;
+}
+
+/// Returns the time it takes @p column to render the cells of all instructions of @p fn
+/// in nanoseconds per instruction, best of a few runs.
+static double measure(const Function& fn, Column& column) {
+  size_t num_insts = 0;
+  for (auto& bb : fn)
+    num_insts += bb.size();
+
+  HtmlArena  arena;
+  CellBuffer cells;
+
+  double best = 0;
+  for (unsigned run = 0; run < 5; run++) {
+    HtmlArena::Scope scope{arena};
+
+    auto start = std::chrono::steady_clock::now();
+
+    for (auto& bb : fn) {
+      cells.clear();
+      column.renderBlock(bb, cells);
+    }
+    /// the nodes of a function are dropped all at once after it has been rendered
+    arena.reset();
+
+    std::chrono::duration<double, std::nano> ns = std::chrono::steady_clock::now() - start;
+    double per_inst = ns.count() / num_insts;
+
+    if (!run || per_inst < best)
+      best = per_inst;
+  }
+  return best;
+}
+
+int main() {
+  LLVMContext ctx;
+  Module      module{"bench", ctx};
+
+  auto fn = makeFunction(module, 20000);
+
+  ModuleSlotTracker slots{&module};
+  ValueNameMangler  names{slots};
+  names.nameFunction(*fn);
+
+  static const char* column_names[] = {"name", "type", "opcode", "operands"};
+
+  auto lambda  = lambdaColumns(names);
+  auto builtin = builtinColumns(names);
+
+  outs() << "column      LambdaRenderer (ns/inst)   BuiltinColumns (ns/inst)   speedup\n";
+
+  double lambda_total = 0, builtin_total = 0;
+  for (size_t idx = 0; idx < lambda.size(); idx++) {
+    double lambda_ns  = measure(*fn, *lambda[idx]);
+    double builtin_ns = measure(*fn, *builtin[idx]);
+
+    lambda_total  += lambda_ns;
+    builtin_total += builtin_ns;
+
+    outs() << format("%-10s  %24.1f   %24.1f   %6.2fx\n", column_names[idx], lambda_ns, builtin_ns, lambda_ns / builtin_ns);
+  }
+  outs() << format("all         %24.1f   %24.1f   %6.2fx\n", lambda_total, builtin_total, lambda_total / builtin_total);
+}
@@ -0,0 +1,94 @@
+// This file is distributed under the Revised BSD Open Source License.
+// See LICENSE.TXT for details.
+
+// microbenchmark for HTML escaping: the old loop writing one char at a time vs html::print_str
+
+#include <llvm/ADT/StringRef.h>
+#include <llvm/Support/Format.h>
+#include <llvm/Support/raw_ostream.h>
+#include <chrono>
+#include <string>
+#include <vector>
+#include "HtmlUtils.hpp"
+
+using namespace llvm;
+
+/// print_str before it was vectorized
+static void print_str_per_char(raw_ostream& OS, StringRef str) {
+  for (char c : str) {
+    switch (c) {
+      case '&': OS << "&amp;"; break;
+      case '<': OS << "&lt;"; break;
+      case '>': OS << "&gt;"; break;
+      case '"': OS << "&quot;"; break;
+      default:  OS << c; break;
+    }
+  }
+}
+
+/// @param length  length of every string
+/// @param special every this many chars one needs escaping, like the `<' & `>' of vector types
+static std::vector<std::string> makeStrings(size_t count, size_t length, size_t special) {
+  static const char chars[] = "abcdefghijklmnopqrstuvwxyz0123456789.%_ ";
+
+  std::vector<std::string> strings(count);
+
+  unsigned seed = 42;
+  for (auto& str : strings) {
+    for (size_t i = 0; i < length; i++) {
+      seed = seed * 1103515245 + 12345;
+      str += (i % special == special - 1) ? '<' : chars[(seed >> 16) % (sizeof(chars) - 1)];
+    }
+  }
+  return strings;
+}
+
+/// Returns the throughput of @p print over all of @p strings in GB/s, best of a few runs.
+template<typename Print>
+static double measure(const std::vector<std::string>& strings, Print print) {
+  size_t bytes = 0;
+  for (auto& str : strings)
+    bytes += str.size();
+
+  /// buffered like the file & string streams pages are printed to, but does not keep anything
+  raw_null_ostream OS;
+
+  double best = 0;
+  for (unsigned run = 0; run < 5; run++) {
+    auto start = std::chrono::steady_clock::now();
+
+    for (unsigned rep = 0; rep < 20; rep++) {
+      for (auto& str : strings)
+        print(OS, str);
+    }
+    OS.flush();
+
+    std::chrono::duration<double> secs = std::chrono::steady_clock::now() - start;
+    best = std::max(best, 20 * bytes / secs.count() / 1e9);
+  }
+  return best;
+}
+
+int main() {
+  struct Workload {
+    const char* name;
+    size_t      count, length, special;
+  };
+
+  static const Workload workloads[] = {
+    {"operands (16 B)",     1 << 20,   16,   64},
+    {"type names (64 B)",   1 << 18,   64,   16},
+    {"long strings (1 KB)", 1 << 14, 1024,  256},
+  };
+
+  outs() << "workload                old loop (GB/s)   print_str (GB/s)   speedup\n";
+
+  for (auto& workload : workloads) {
+    auto strings = makeStrings(workload.count, workload.length, workload.special);
+
+    double old_gbs = measure(strings, print_str_per_char);
+    double new_gbs = measure(strings, html::print_str);
+
+    outs() << format("%-22s  %15.2f   %16.2f   %6.2fx\n", workload.name, old_gbs, new_gbs, new_gbs / old_gbs);
+  }
+}
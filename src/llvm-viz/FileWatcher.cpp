@@ -0,0 +1,126 @@
+// This file is distributed under the Revised BSD Open Source License.
+// See LICENSE.TXT for details.
+
+#include "FileWatcher.hpp"
+#include <llvm/ADT/SmallString.h>
+#include <llvm/Support/FileSystem.h>
+#include <llvm/Support/Path.h>
+#include <chrono>
+#include <thread>
+
+#ifdef __linux__
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+using namespace html;
+using namespace llvm;
+
+/// changes closer together than this are merged into one
+static const int DEBOUNCE_MS = 100;
+
+/// how often the file is checked when we have no inotify
+static const int POLL_INTERVAL_MS = 500;
+
+FileWatcher::FileWatcher(StringRef path)
+: _path{path}
+, _name{sys::path::filename(path).str()}
+{
+  statChanged();
+
+#ifdef __linux__
+  SmallString<128> dir{path};
+  sys::fs::make_absolute(dir);
+  sys::path::remove_filename(dir);
+
+  _inotify = inotify_init1(IN_CLOEXEC);
+
+  if (_inotify >= 0) {
+    auto mask = IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE;
+
+    if (inotify_add_watch(_inotify, dir.c_str(), mask) < 0) {
+      close(_inotify);
+      _inotify = -1;
+    }
+  }
+#endif
+}
+
+FileWatcher::~FileWatcher() {
+#ifdef __linux__
+  if (_inotify >= 0)
+    close(_inotify);
+#endif
+}
+
+void FileWatcher::wait() {
+  if (_inotify >= 0)
+    waitInotify();
+  else
+    waitPolling();
+}
+
+void FileWatcher::waitInotify() {
+#ifdef __linux__
+  alignas(struct inotify_event) char buf[4096];
+
+  /// Reads pending events, returns true if one of them is about our file.
+  /// Blocks for at most timeout_ms, or forever if it is negative.
+  auto readEvents = [&](int timeout_ms) -> bool {
+    pollfd pfd{_inotify, POLLIN, 0};
+
+    if (poll(&pfd, 1, timeout_ms) <= 0)
+      return false;
+
+    ssize_t len = read(_inotify, buf, sizeof(buf));
+    if (len <= 0)
+      return false;
+
+    bool match = false;
+
+    for (char* ptr = buf; ptr < buf + len;) {
+      auto event = reinterpret_cast<const struct inotify_event*>(ptr);
+
+      if (event->len && (_name == event->name))
+        match = true;
+
+      ptr += sizeof(struct inotify_event) + event->len;
+    }
+    return match;
+  };
+
+  while (!readEvents(-1)) {}
+
+  /// wait for the writer to finish, programs often write a file in several steps
+  while (readEvents(DEBOUNCE_MS)) {}
+
+  statChanged();
+#endif
+}
+
+void FileWatcher::waitPolling() {
+  while (!statChanged())
+    std::this_thread::sleep_for(std::chrono::milliseconds(POLL_INTERVAL_MS));
+
+  do {
+    std::this_thread::sleep_for(std::chrono::milliseconds(DEBOUNCE_MS));
+  } while (statChanged());
+}
+
+bool FileWatcher::statChanged() {
+  sys::fs::file_status status;
+
+  bool exists = !sys::fs::status(_path, status) && sys::fs::exists(status);
+
+  sys::TimePoint<> mtime = exists ? status.getLastModificationTime() : sys::TimePoint<>{};
+  uint64_t         size  = exists ? status.getSize() : 0;
+
+  bool changed = (exists != _exists) || (mtime != _mtime) || (size != _size);
+
+  _exists = exists;
+  _mtime  = mtime;
+  _size   = size;
+
+  return changed;
+}
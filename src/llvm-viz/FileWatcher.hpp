@@ -0,0 +1,50 @@
+// This file is distributed under the Revised BSD Open Source License.
+// See LICENSE.TXT for details.
+
+#pragma once
+
+#include <llvm/ADT/StringRef.h>
+#include <llvm/Support/Chrono.h>
+#include <cstdint>
+#include <string>
+
+namespace html {
+
+using namespace llvm;
+
+/***
+ * Waits for changes to a single file.
+ *
+ * Uses inotify on Linux, falls back to polling the modification time elsewhere or if inotify is not available.
+ * The directory containing the file is watched, not the file itself,
+ * so we also notice editors & build systems replacing the file by moving a new one over it.
+ */
+struct FileWatcher {
+  /// Changes are tracked from the moment the watcher is created on.
+  FileWatcher(StringRef path);
+  ~FileWatcher();
+
+  FileWatcher(const FileWatcher&) = delete;
+  FileWatcher& operator=(const FileWatcher&) = delete;
+
+  /// Blocks until the file was written, replaced or re-created.
+  /// Bursts of changes in quick succession only end one wait.
+  void wait();
+private:
+  void waitInotify();
+  void waitPolling();
+
+  /// remembers modification time & size of the file, returns true if they changed since the last call
+  bool statChanged();
+
+  std::string _path;
+  std::string _name; // file name of _path without the directory
+
+  int _inotify = -1;
+
+  sys::TimePoint<> _mtime;
+  uint64_t         _size   = 0;
+  bool             _exists = false;
+};
+
+} // end namespace html
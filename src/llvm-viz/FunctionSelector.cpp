@@ -0,0 +1,194 @@
+// This file is distributed under the Revised BSD Open Source License.
+// See LICENSE.TXT for details.
+
+#include "FunctionSelector.hpp"
+#include <llvm/ADT/DenseMap.h>
+#include <llvm/ADT/Optional.h>
+#include <llvm/ADT/SmallVector.h>
+#include <llvm/Analysis/LoopInfo.h>
+#include <llvm/Demangle/Demangle.h>
+#include <llvm/IR/Dominators.h>
+#include <llvm/IR/Instructions.h>
+#include <llvm/IR/Module.h>
+#include <llvm/Support/Error.h>
+#include <llvm/Support/GlobPattern.h>
+#include <llvm/Support/Regex.h>
+#include <llvm/Support/raw_ostream.h>
+#include <cstdlib>
+
+using namespace html;
+using namespace llvm;
+
+bool FunctionSelection::empty() const {
+  return name_regex.empty() && name_glob.empty() && demangled_regex.empty() && !needsFunctionBodies();
+}
+
+bool FunctionSelection::needsFunctionBodies() const {
+  return min_instructions || min_loop_depth || !call_graph_root.empty();
+}
+
+[[noreturn]] static void invalidSelection(const Twine& msg) {
+  errs() << "llvm-viz: " << msg << "\n";
+  exit(1);
+}
+
+static Regex compileRegex(StringRef option, const std::string& pattern) {
+  Regex regex{pattern};
+  std::string error;
+
+  if (!regex.isValid(error))
+    invalidSelection(Twine("Invalid regex `") + pattern + "' for " + option + ": " + error);
+
+  return regex;
+}
+
+static std::string demangle(const Function& fn) {
+  std::string name = fn.getName().str();
+
+  int status = 0;
+  char* demangled = itaniumDemangle(name.c_str(), nullptr, nullptr, &status);
+
+  if (demangled) {
+    if (status == 0)
+      name = demangled;
+    free(demangled);
+  }
+  return name;
+}
+
+static unsigned countInstructions(const Function& fn) {
+  unsigned count = 0;
+  for (auto& bb : fn)
+    count += bb.size();
+  return count;
+}
+
+static unsigned maxLoopDepth(const Function& fn) {
+  DominatorTree domTree{const_cast<Function&>(fn)};
+  LoopInfo      loops{domTree};
+
+  unsigned depth = 0;
+  for (auto& bb : fn)
+    depth = std::max(depth, loops.getLoopDepth(&bb));
+  return depth;
+}
+
+static const Function* directCallee(const Instruction& inst) {
+  if (auto call = dyn_cast<CallInst>(&inst))
+    return call->getCalledFunction();
+  if (auto invoke = dyn_cast<InvokeInst>(&inst))
+    return invoke->getCalledFunction();
+  return nullptr;
+}
+
+std::vector<bool> html::selectFunctions(Module& m, const FunctionSelection& selection) {
+  Optional<Regex>       name_regex, demangled_regex;
+  Optional<GlobPattern> name_glob;
+
+  if (!selection.name_regex.empty())
+    name_regex = compileRegex("-select-name", selection.name_regex);
+  if (!selection.demangled_regex.empty())
+    demangled_regex = compileRegex("-select-demangled", selection.demangled_regex);
+  if (!selection.name_glob.empty()) {
+    auto glob = GlobPattern::create(selection.name_glob);
+    if (!glob) {
+      std::string error;
+      raw_string_ostream OS{error};
+      logAllUnhandledErrors(glob.takeError(), OS, "");
+      invalidSelection(Twine("Invalid glob `") + selection.name_glob + "' for -select-glob: " + StringRef(OS.str()).trim());
+    }
+    name_glob = std::move(*glob);
+  }
+
+  const Function* root = nullptr;
+  if (!selection.call_graph_root.empty()) {
+    root = m.getFunction(selection.call_graph_root);
+    if (!root)
+      invalidSelection(Twine("No function named `") + selection.call_graph_root + "' for -select-around");
+  }
+
+  std::vector<bool>                   selected;
+  DenseMap<const Function*, unsigned> index;
+
+  /// edges of the call graph, both directions, for finding the neighbourhood of the root
+  std::vector<SmallVector<unsigned, 4>> neighbours;
+
+  for (Function& fn : m) {
+    index[&fn] = selected.size();
+    selected.push_back(false);
+  }
+  if (root)
+    neighbours.resize(selected.size());
+
+  for (Function& fn : m) {
+    const unsigned idx = index[&fn];
+
+    if (fn.isDeclaration() && !fn.isMaterializable())
+      continue;
+
+    /// name based criteria don't need the function body
+    const bool name_matches = (!name_regex      || name_regex->match(fn.getName())) &&
+                              (!name_glob       || name_glob->match(fn.getName())) &&
+                              (!demangled_regex || demangled_regex->match(demangle(fn)));
+
+    if (!selection.needsFunctionBodies() || (!name_matches && !root)) {
+      selected[idx] = name_matches;
+      continue;
+    }
+
+    const bool lazy = fn.isMaterializable();
+    if (lazy) {
+      if (auto err = fn.materialize()) {
+        logAllUnhandledErrors(std::move(err), errs(), "llvm-viz: Could not load function `" + fn.getName() + "': ");
+        exit(1);
+      }
+    }
+
+    selected[idx] = name_matches &&
+                    (countInstructions(fn) >= selection.min_instructions) &&
+                    (!selection.min_loop_depth || maxLoopDepth(fn) >= selection.min_loop_depth);
+
+    if (root) {
+      for (auto& bb : fn) {
+        for (auto& inst : bb) {
+          if (auto callee = directCallee(inst)) {
+            const unsigned callee_idx = index[callee];
+
+            neighbours[idx].push_back(callee_idx);
+            neighbours[callee_idx].push_back(idx);
+          }
+        }
+      }
+    }
+
+    if (lazy)
+      fn.deleteBody();
+  }
+
+  /// the call graph is only complete once we have seen all bodies, so restricting to the neighbourhood of the root
+  /// has to come last. Paths may lead through functions that are not selected themselves.
+  if (root) {
+    std::vector<unsigned> distance(selected.size(), ~0u);
+    std::vector<unsigned> worklist{index[root]};
+
+    distance[index[root]] = 0;
+    for (size_t i = 0; i < worklist.size(); i++) {
+      const unsigned current = worklist[i];
+
+      if (distance[current] == selection.call_graph_hops)
+        continue;
+
+      for (unsigned next : neighbours[current]) {
+        if (distance[next] == ~0u) {
+          distance[next] = distance[current] + 1;
+          worklist.push_back(next);
+        }
+      }
+    }
+
+    for (size_t i = 0; i < selected.size(); i++)
+      selected[i] = selected[i] && (distance[i] != ~0u);
+  }
+
+  return selected;
+}
@@ -0,0 +1,44 @@
+// This file is distributed under the Revised BSD Open Source License.
+// See LICENSE.TXT for details.
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+namespace llvm {
+  class Module;
+}
+
+namespace html {
+
+using namespace llvm;
+
+/***
+ * Criteria for restricting which functions of a module get rendered.
+ * A function is selected if it has a body and meets all criteria that are set.
+ */
+struct FunctionSelection {
+  std::string name_regex;       ///< regex the (mangled) name has to match
+  std::string name_glob;        ///< glob pattern the (mangled) name has to match
+  std::string demangled_regex;  ///< regex the demangled name has to match
+  unsigned    min_instructions = 0;
+  unsigned    min_loop_depth   = 0;
+
+  /// only select functions at most `call_graph_hops' direct calls away from this function, callers and callees alike
+  std::string call_graph_root;
+  unsigned    call_graph_hops = 0;
+
+  /// Are there any criteria at all?
+  bool empty() const;
+
+  /// Do we have to look at function bodies to decide which functions are selected?
+  bool needsFunctionBodies() const;
+};
+
+/// Returns for each function of @p m, in module order, whether it is selected.
+/// Lazily loaded function bodies are materialized if the selection needs them and deleted again right after.
+/// Prints an error and exits if the criteria are malformed.
+std::vector<bool> selectFunctions(Module& m, const FunctionSelection& selection);
+
+} // end namespace html
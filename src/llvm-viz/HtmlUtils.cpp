@@ -5,7 +5,16 @@
 #include "HtmlUtils.hpp"
 #include <llvm/IR/Value.h>
 #include <llvm/IR/Type.h>
+#include <llvm/Support/MathExtras.h>
 #include <support/PrintUtils.hpp>
+#include <algorithm>
+#include <cctype>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
 
 using namespace llvm;
 using namespace html;
@@ -14,6 +23,40 @@ static void indent(unsigned indent_lvl, raw_ostream& OS);
 static void nl(unsigned indent_lvl, raw_ostream& OS);
 static unsigned inc_indent(unsigned indent_lvl);
 
+LLVM_THREAD_LOCAL HtmlArena* HtmlArena::_current = nullptr;
+
+void HtmlArena::reset() {
+  for (NodeHeader* node = _last_node; node;) {
+    NodeHeader* prev = node->prev;
+    reinterpret_cast<Html*>(node + 1)->~Html();
+    node = prev;
+  }
+  _last_node = nullptr;
+
+  _alloc.Reset();
+}
+
+void* HtmlArena::allocateNode(size_t size) {
+  static_assert(alignof(SimpleTag)   <= alignof(NodeHeader), "HTML node needs stricter alignment than arena provides");
+  static_assert(alignof(VerbatimTag) <= alignof(NodeHeader), "HTML node needs stricter alignment than arena provides");
+  static_assert(alignof(RawHtml)     <= alignof(NodeHeader), "HTML node needs stricter alignment than arena provides");
+
+  auto node = static_cast<NodeHeader*>(_alloc.Allocate(sizeof(NodeHeader) + size, alignof(NodeHeader)));
+  node->prev = _last_node;
+  _last_node = node;
+
+  return node + 1;
+}
+
+StringRef HtmlArena::save(StringRef str) {
+  if (str.empty())
+    return StringRef{};
+
+  auto mem = static_cast<char*>(_alloc.Allocate(str.size(), 1));
+  std::copy(str.begin(), str.end(), mem);
+  return StringRef{mem, str.size()};
+}
+
 void html::HtmlEscapedString::_print(raw_ostream &OS, unsigned indent_lvl) const {
   if (_txt.empty())
     return;
@@ -32,6 +75,10 @@ void html::HtmlEntity::_print(raw_ostream &OS, unsigned indent_lvl) const {
   nl(indent_lvl, OS);
 }
 
+void html::RawHtml::_print(raw_ostream &OS, unsigned indent_lvl) const {
+  OS << _txt;
+}
+
 StringRef html::HtmlEntity::str() const {
   switch (_entity) {
     case TIMES: return "&times;";
@@ -55,15 +102,29 @@ void SimpleTag::_print(raw_ostream &OS, unsigned indent_lvl) const {
   if (style() == FlowStyle)
     indent_lvl = FLOW_STYLE;
 
+  printOpen(OS, indent_lvl);
+
+  for (auto html : _body)
+    html->print(OS, inc_indent(indent_lvl));
+
+  printClose(OS, indent_lvl);
+}
+
+void SimpleTag::printOpen(raw_ostream &OS, unsigned indent_lvl) const {
+  if (style() == FlowStyle)
+    indent_lvl = FLOW_STYLE;
+
   indent(indent_lvl, OS);
 
   OS << '<' << _tag;
   print_attrs(OS, _attrs);
   OS << '>';
   nl(indent_lvl, OS);
+}
 
-  for (auto html : _body)
-    html->print(OS, inc_indent(indent_lvl));
+void SimpleTag::printClose(raw_ostream &OS, unsigned indent_lvl) const {
+  if (style() == FlowStyle)
+    indent_lvl = FLOW_STYLE;
 
   indent(indent_lvl, OS);
   print_close(OS, _tag);
@@ -89,7 +150,23 @@ void VerbatimTag::_print(raw_ostream &OS, unsigned indent_lvl) const {
   OS << '>';
   nl(indent_lvl, OS);
 
-  LongStringLiteral{_body}.print(OS, indent_lvl + 2);
+  if (_preformatted) {
+    OS << _body;
+    if (!StringRef{_body}.endswith("\n"))
+      nl(indent_lvl, OS);
+  } else if (indent_lvl == FLOW_STYLE) {
+    /// no indentation at all, but keep the line breaks, JS may need them
+    for (StringRef rest = _body; !rest.empty();) {
+      StringRef line;
+      std::tie(line, rest) = rest.split('\n');
+
+      line = line.trim();
+      if (!line.empty())
+        OS << line << '\n';
+    }
+  } else {
+    LongStringLiteral{_body}.print(OS, inc_indent(indent_lvl));
+  }
 
   indent(indent_lvl, OS);
   print_close(OS, _tag);
@@ -98,17 +175,91 @@ void VerbatimTag::_print(raw_ostream &OS, unsigned indent_lvl) const {
 }
 
 
+/// Characters that need to be escaped are `&<>"'.
+/// Their codes pair up nicely so the vector kernels only need two compares instead of four:
+///   '"' = 0x22, '&' = 0x26  ->  (c | 0x04) == '&'
+///   '<' = 0x3C, '>' = 0x3E  ->  (c | 0x02) == '>'
+static bool is_special_char(char c) {
+  return ((c | 0x04) == '&') || ((c | 0x02) == '>');
+}
+
+/// Returns the index of the first character in @p str that has to be escaped, or str.size() if there is none.
+static size_t find_special_char(StringRef str) {
+  const char*  data = str.data();
+  const size_t size = str.size();
+
+  size_t i = 0;
+
+#if defined(__AVX2__)
+  {
+    const __m256i amp_bit = _mm256_set1_epi8(0x04), amp = _mm256_set1_epi8('&');
+    const __m256i gt_bit  = _mm256_set1_epi8(0x02), gt  = _mm256_set1_epi8('>');
+
+    for (; i + 32 <= size; i += 32) {
+      __m256i chunk = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i));
+
+      __m256i is_amp = _mm256_cmpeq_epi8(_mm256_or_si256(chunk, amp_bit), amp);
+      __m256i is_gt  = _mm256_cmpeq_epi8(_mm256_or_si256(chunk, gt_bit),  gt);
+
+      unsigned mask = static_cast<unsigned>(_mm256_movemask_epi8(_mm256_or_si256(is_amp, is_gt)));
+
+      if (mask)
+        return i + countTrailingZeros(mask);
+    }
+  }
+#endif
+
+#if defined(__SSE2__)
+  {
+    const __m128i amp_bit = _mm_set1_epi8(0x04), amp = _mm_set1_epi8('&');
+    const __m128i gt_bit  = _mm_set1_epi8(0x02), gt  = _mm_set1_epi8('>');
+
+    for (; i + 16 <= size; i += 16) {
+      __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+
+      __m128i is_amp = _mm_cmpeq_epi8(_mm_or_si128(chunk, amp_bit), amp);
+      __m128i is_gt  = _mm_cmpeq_epi8(_mm_or_si128(chunk, gt_bit),  gt);
+
+      unsigned mask = static_cast<unsigned>(_mm_movemask_epi8(_mm_or_si128(is_amp, is_gt)));
+
+      if (mask)
+        return i + countTrailingZeros(mask);
+    }
+  }
+#endif
+
+  /// scalar fallback & tail
+  for (; i < size; i++) {
+    if (is_special_char(data[i]))
+      return i;
+  }
+
+  return size;
+}
+
 void html::print_str(raw_ostream& OS, StringRef str) {
-  for (char c : str) {
-    assert(isprint(c));
+  /// tabs and UTF-8 sequences show up in source code
+  assert(std::all_of(str.begin(), str.end(), [](char c) { return (c & 0x80) || isprint(static_cast<unsigned char>(c)) || (c == '\t'); }));
+
+  /// write runs of characters that need no escaping in one go
+  while (true) {
+    size_t pos = find_special_char(str);
 
-    switch (c) {
+    if (pos)
+      OS.write(str.data(), pos);
+
+    if (pos == str.size())
+      return;
+
+    switch (str[pos]) {
       case '&': OS << "&amp;"; break;
       case '<': OS << "&lt;"; break;
       case '>': OS << "&gt;"; break;
       case '"': OS << "&quot;"; break;
-      default:  OS << c; break;
+      default: llvm_unreachable("not a special HTML char");
     }
+
+    str = str.drop_front(pos + 1);
   }
 }
 
@@ -7,7 +7,9 @@
 #include <llvm/ADT/Twine.h>
 #include <llvm/ADT/SmallString.h>
 #include <llvm/ADT/Optional.h>
+#include <llvm/Support/Allocator.h>
 #include <llvm/Support/Casting.h>
+#include <llvm/Support/Compiler.h>
 #include <llvm/Support/raw_ostream.h>
 #include <vector>
 
@@ -21,11 +23,62 @@ namespace html {
 
 using namespace llvm;
 
+/// Owns all Html nodes created while it is the active arena (see HtmlArena::Scope).
+/// Nodes are bump allocated and only destroyed all at once when the arena is reset or destroyed,
+/// so a whole DOM subtree can be dropped in one go once it has been printed.
+struct HtmlArena {
+  HtmlArena() {}
+  HtmlArena(const HtmlArena&) = delete;
+  HtmlArena& operator=(const HtmlArena&) = delete;
+
+  ~HtmlArena() { reset(); }
+
+  /// Destroy all nodes allocated in this arena and release their memory.
+  void reset();
+
+  /// Allocate memory for a node. The node is destroyed when the arena is reset.
+  void* allocateNode(size_t size);
+
+  /// Copy a string into the arena, it lives until the arena is reset.
+  StringRef save(StringRef str);
+
+  size_t bytesAllocated() const { return _alloc.getBytesAllocated(); }
+
+  /// The arena new nodes are allocated in, every thread has its own.
+  static HtmlArena& current() {
+    assert(_current && "No active HtmlArena, create an HtmlArena::Scope first");
+    return *_current;
+  }
+
+  /// Makes an arena the target for all node allocations for the lifetime of the scope.
+  struct Scope {
+    explicit Scope(HtmlArena& arena) : _prev{_current} { _current = &arena; }
+    ~Scope() { _current = _prev; }
+
+    Scope(const Scope&) = delete;
+    Scope& operator=(const Scope&) = delete;
+  private:
+    HtmlArena* _prev;
+  };
+private:
+  /// Placed in front of every node so we can find all of them again to run their destructors.
+  struct NodeHeader {
+    NodeHeader* prev;
+  };
+
+  BumpPtrAllocator _alloc;
+  NodeHeader*      _last_node = nullptr;
+
+  static LLVM_THREAD_LOCAL HtmlArena* _current;
+};
+
 struct Html {
   enum Kind {
     K_EscapedString,
     K_HtmlEntity,
 
+    K_RawHtml,     // already rendered HTML that is printed as is
+
     K_SimpleTag,   // tag with children, strings are escaped
     K_EmptyTag,    // tag without children
     K_VerbatimTag, // tag which contains only a string, string is *NOT* escaped
@@ -43,6 +96,12 @@ struct Html {
 
   virtual ~Html() {}
 
+  /// Nodes always live in the current HtmlArena and are never deleted individually.
+  static void* operator new(size_t size) {
+    return HtmlArena::current().allocateNode(size);
+  }
+  static void operator delete(void*) {}
+
   void print(raw_ostream& OS, unsigned indent = 0) const {
     _print(OS, indent);
   }
@@ -62,6 +121,7 @@ private:
 
   friend class HtmlString;
   friend class HtmlTag;
+  friend class RawHtml;
 };
 
 struct HtmlString : Html {
@@ -78,9 +138,9 @@ private:
 };
 
 /// HTML string where special characters are escaped before printing
+/// The text is copied into the current HtmlArena.
 struct HtmlEscapedString : HtmlString {
-  HtmlEscapedString(std::string&& txt) : HtmlString{K_EscapedString}, _txt{std::move(txt)} {}
-  HtmlEscapedString(const std::string& txt) : HtmlString{K_EscapedString}, _txt{txt} {}
+  HtmlEscapedString(StringRef txt) : HtmlString{K_EscapedString}, _txt{HtmlArena::current().save(txt)} {}
 
   static bool classof(const Html *html) {
     return html->kind() == K_EscapedString;
@@ -90,7 +150,7 @@ struct HtmlEscapedString : HtmlString {
 private:
   void _print(raw_ostream& OS, unsigned indent) const override;
 
-  std::string _txt;
+  StringRef _txt;
 };
 
 struct HtmlEntity : HtmlString {
@@ -112,6 +172,23 @@ private:
   Entity _entity;
 };
 
+/// HTML that has already been printed, e.g. a function rendered in its own arena.
+/// It is printed as is, the indent passed to print() is ignored.
+struct RawHtml : Html {
+  /// @p txt is copied into the current arena
+  RawHtml(StringRef txt) : Html{K_RawHtml}, _txt{HtmlArena::current().save(txt)} {}
+
+  static bool classof(const Html *html) {
+    return html->kind() == K_RawHtml;
+  }
+
+  StringRef str() const { return _txt; }
+private:
+  void _print(raw_ostream& OS, unsigned indent) const override;
+
+  StringRef _txt;
+};
+
 struct HtmlAttr {
   /// Create a value-less attribute (like `checked' in checkbox inputs)
   explicit HtmlAttr(const Twine& name) : _name{name.str()} {}
@@ -240,6 +317,14 @@ struct SimpleTag : HtmlTag {
 
   Body::iterator begin() { return _body.begin(); }
   Body::iterator end()   { return _body.end(); }
+
+  /// Print only the opening tag.
+  /// Together with printClose() this allows streaming children to a stream one by one,
+  /// children should be printed with an indent of indent + 2.
+  void printOpen(raw_ostream& OS, unsigned indent = 0) const;
+
+  /// Print only the closing tag, see printOpen().
+  void printClose(raw_ostream& OS, unsigned indent = 0) const;
 private:
   void _add(Html* html) {
     _body.push_back(html);
@@ -250,7 +335,7 @@ private:
   }
 
   void _add(StringRef txt) {
-    _body.push_back(new HtmlEscapedString{txt.str()});
+    _body.push_back(new HtmlEscapedString{txt});
   }
 
   void _print(raw_ostream& OS, unsigned indent) const override;
@@ -284,10 +369,18 @@ struct VerbatimTag : HtmlTag {
   void append(const Twine& t) {
     t.toVector(_body);
   }
+
+  /// Print the body exactly as it is, instead of re-indenting it.
+  /// For code that is minified already, like the JS & CSS frameworks we embed.
+  VerbatimTag* preformatted() {
+    _preformatted = true;
+    return this;
+  }
 private:
   void _print(raw_ostream& OS, unsigned indent) const override;
 
   SmallString<16> _body;
+  bool            _preformatted = false;
 };
 
 template<typename Visitor>
@@ -307,6 +400,7 @@ void SimpleTag::accept(Visitor&& visitor) {
         break;
       case K_EscapedString:
       case K_HtmlEntity:
+      case K_RawHtml:
         break;
       default:
         llvm_unreachable("Garbage kind in HTML AST node!");
@@ -332,7 +426,8 @@ using HtmlBody  = std::initializer_list<Html*>;
   }
 
 inline HtmlEscapedString* str(const Twine& txt) {
-  return new HtmlEscapedString{txt.str()};
+  SmallString<64> buf;
+  return new HtmlEscapedString{txt.toStringRef(buf)};
 }
 
 template<typename... Args> \
@@ -386,6 +481,21 @@ inline VerbatimTag* style(const Twine& source) {
   return new VerbatimTag{"style", source};
 }
 
+/// <script> tag that loads the code from @p url instead of containing it
+inline SimpleTag* external_script(const Twine& url) {
+  auto tag = new SimpleTag{"script", {}, {}};
+  tag->addAttr("src", url.str());
+  return tag;
+}
+
+/// <link> tag that loads a style sheet from @p url
+inline EmptyTag* stylesheet(const Twine& url) {
+  auto tag = new EmptyTag{"link"};
+  tag->addAttr("rel", "stylesheet");
+  tag->addAttr("href", url.str());
+  return tag;
+}
+
 inline HtmlAttr attr(const Twine& name, const Twine& value) {
   return HtmlAttr{name.str(), value.str()};
 }
@@ -0,0 +1,181 @@
+// This file is distributed under the Revised BSD Open Source License.
+// See LICENSE.TXT for details.
+
+#include "HttpServer.hpp"
+#include <llvm/ADT/SmallString.h>
+#include <llvm/ADT/Twine.h>
+#include <llvm/Support/raw_ostream.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+
+using namespace html;
+using namespace llvm;
+
+/// requests with larger headers are rejected, we only ever get simple GETs
+static const size_t MAX_REQUEST_SIZE = 64 * 1024;
+
+/// clients that do not send a complete request in time are dropped, they would block everyone else
+static const int RECEIVE_TIMEOUT_SECONDS = 5;
+
+#ifdef MSG_NOSIGNAL
+static const int SEND_FLAGS = MSG_NOSIGNAL; // a client going away must not kill us with SIGPIPE
+#else
+static const int SEND_FLAGS = 0;
+#endif
+
+[[noreturn]] static void fail(const Twine& msg) {
+  errs() << "llvm-viz: " << msg << "\n";
+  exit(1);
+}
+
+static StringRef reasonPhrase(unsigned status) {
+  switch (status) {
+    case 200: return "OK";
+    case 400: return "Bad Request";
+    case 404: return "Not Found";
+    case 405: return "Method Not Allowed";
+    default:  return "Internal Server Error";
+  }
+}
+
+static bool sendAll(int fd, StringRef data) {
+  while (!data.empty()) {
+    ssize_t sent = send(fd, data.data(), data.size(), SEND_FLAGS);
+
+    if (sent < 0 && errno == EINTR)
+      continue;
+    if (sent <= 0)
+      return false;
+
+    data = data.drop_front(sent);
+  }
+  return true;
+}
+
+HttpServer::HttpServer(StringRef address) {
+  StringRef host, port;
+  std::tie(host, port) = address.rsplit(':');
+
+  if (port.empty() && !address.endswith(":")) {
+    port = host;
+    host = "";
+  }
+
+  if (!host.empty() && (host != "localhost") && (host != "127.0.0.1"))
+    fail(Twine("Can only serve on localhost, not on `") + host + "'");
+
+  if (port.getAsInteger(10, _port) || (_port > 65535))
+    fail(Twine("Invalid port `") + port + "' in address `" + address + "'");
+
+  _socket = socket(AF_INET, SOCK_STREAM, 0);
+  if (_socket < 0)
+    fail(Twine("Could not create socket: ") + strerror(errno));
+
+  int yes = 1;
+  setsockopt(_socket, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof(yes));
+
+  sockaddr_in addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family      = AF_INET;
+  addr.sin_port        = htons(_port);
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+  if (bind(_socket, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0)
+    fail("Could not listen on port " + Twine(_port) + ": " + strerror(errno));
+
+  if (listen(_socket, 16) < 0)
+    fail("Could not listen on port " + Twine(_port) + ": " + strerror(errno));
+
+  /// port 0 picks any free port, find out which one we got
+  socklen_t len = sizeof(addr);
+  if (getsockname(_socket, reinterpret_cast<sockaddr*>(&addr), &len) == 0)
+    _port = ntohs(addr.sin_port);
+}
+
+HttpServer::~HttpServer() {
+  if (_socket >= 0)
+    close(_socket);
+}
+
+std::string HttpServer::url() const {
+  return "http://localhost:" + std::to_string(_port) + "/";
+}
+
+void HttpServer::serve(const Handler& handler) {
+  for (;;) {
+    int client = accept(_socket, nullptr, nullptr);
+
+    if (client < 0) {
+      if (errno == EINTR || errno == ECONNABORTED)
+        continue;
+      fail(Twine("Could not accept connection: ") + strerror(errno));
+    }
+
+    timeval timeout{RECEIVE_TIMEOUT_SECONDS, 0};
+    setsockopt(client, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+    handleConnection(client, handler);
+    close(client);
+  }
+}
+
+void HttpServer::handleConnection(int fd, const Handler& handler) {
+  std::string request;
+
+  while (request.find("\r\n\r\n") == std::string::npos) {
+    if (request.size() > MAX_REQUEST_SIZE)
+      return;
+
+    char buf[4096];
+    ssize_t len = recv(fd, buf, sizeof(buf), 0);
+
+    if (len < 0 && errno == EINTR)
+      continue;
+    if (len <= 0)
+      return;
+
+    request.append(buf, len);
+  }
+
+  /// request line: METHOD SP TARGET SP VERSION
+  StringRef line = StringRef{request}.split("\r\n").first;
+
+  StringRef method, target, version;
+  std::tie(method, line)    = line.split(' ');
+  std::tie(target, version) = line.split(' ');
+
+  Response response;
+
+  if (!target.startswith("/") || !version.startswith("HTTP/")) {
+    response.status = 400;
+  } else if ((method != "GET") && (method != "HEAD")) {
+    response.status = 405;
+  } else {
+    handler(target.split('?').first, response);
+  }
+
+  if (response.status != 200) {
+    response.content_type = "text/plain; charset=utf-8";
+    response.body         = (Twine(response.status) + " " + reasonPhrase(response.status) + "\n").str();
+  }
+
+  SmallString<256> header;
+  {
+    raw_svector_ostream OS{header};
+
+    OS << "HTTP/1.1 " << response.status << ' ' << reasonPhrase(response.status) << "\r\n";
+    OS << "Content-Type: " << response.content_type << "\r\n";
+    OS << "Content-Length: " << response.body.size() << "\r\n";
+    OS << "Cache-Control: no-cache\r\n";
+    OS << "Connection: close\r\n";
+    OS << "\r\n";
+  }
+
+  if (sendAll(fd, header) && (method != "HEAD"))
+    sendAll(fd, response.body);
+}
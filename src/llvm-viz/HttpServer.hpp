@@ -0,0 +1,50 @@
+// This file is distributed under the Revised BSD Open Source License.
+// See LICENSE.TXT for details.
+
+#pragma once
+
+#include <llvm/ADT/StringRef.h>
+#include <functional>
+#include <string>
+
+namespace html {
+
+using namespace llvm;
+
+/***
+ * Minimal HTTP/1.1 server for viewing a module in the browser.
+ *
+ * Only listens on the loopback interface and only answers GET & HEAD requests.
+ * Requests are handled one after the other on the thread calling serve(), every connection is closed after one response.
+ */
+struct HttpServer {
+  struct Response {
+    unsigned    status       = 200;
+    std::string content_type = "text/html; charset=utf-8";
+    std::string body;
+  };
+
+  /// Fills in the response for the given path, which always starts with a '/'. Query strings are stripped.
+  using Handler = std::function<void(StringRef path, Response& response)>;
+
+  /// Starts listening, prints an error and exits if that fails.
+  /// @param address  port to listen on, optionally preceded by "localhost:" or "127.0.0.1:", like ":8080"
+  HttpServer(StringRef address);
+  ~HttpServer();
+
+  HttpServer(const HttpServer&) = delete;
+  HttpServer& operator=(const HttpServer&) = delete;
+
+  /// URL of the root of the server
+  std::string url() const;
+
+  /// Handles requests forever.
+  [[noreturn]] void serve(const Handler& handler);
+private:
+  void handleConnection(int fd, const Handler& handler);
+
+  int      _socket = -1;
+  unsigned _port   = 0;
+};
+
+} // end namespace html
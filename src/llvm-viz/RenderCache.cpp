@@ -0,0 +1,259 @@
+// This file is distributed under the Revised BSD Open Source License.
+// See LICENSE.TXT for details.
+
+#include "RenderCache.hpp"
+#include "ValueNameMangler.hpp"
+#include <llvm/ADT/DenseMap.h>
+#include <llvm/ADT/SetVector.h>
+#include <llvm/ADT/SmallString.h>
+#include <llvm/Config/llvm-config.h>
+#include <llvm/IR/Function.h>
+#include <llvm/IR/Instruction.h>
+#include <llvm/IR/Metadata.h>
+#include <llvm/IR/Module.h>
+#include <llvm/IR/ModuleSlotTracker.h>
+#include <llvm/Support/FileSystem.h>
+#include <llvm/Support/MD5.h>
+#include <llvm/Support/MemoryBuffer.h>
+#include <llvm/Support/Path.h>
+#include <llvm/Support/raw_ostream.h>
+#include <cctype>
+
+using namespace html;
+using namespace llvm;
+
+/// Bump whenever the HTML generated for a function changes in a way not covered by the renderer configuration,
+/// so fragments written by older versions of llvm-viz are not reused.
+static const unsigned FORMAT_VERSION = 5;
+
+namespace {
+
+/// Feeds everything printed to it into an MD5 hash.
+/// Metadata slot numbers, like the 42 in "!42", are left out since they depend on the rest of the module.
+/// Same for addresses printed for metadata the slot tracker does not know about, like the ones of lazily loaded functions.
+/// The contents of referenced metadata is hashed instead, see KeyBuilder.
+struct HashStream final : raw_ostream {
+  HashStream(MD5& md5) : _md5{md5} {}
+
+  ~HashStream() override {
+    flush();
+  }
+private:
+  void write_impl(const char* ptr, size_t size) override {
+    SmallString<256> buf;
+
+    for (const char c : StringRef{ptr, size}) {
+      if (_in_slot && isdigit(static_cast<unsigned char>(c)))
+        continue;
+      if (_in_address && isxdigit(static_cast<unsigned char>(c)))
+        continue;
+      _in_slot    = false;
+      _in_address = false;
+
+      /// quotes inside of names & strings are printed escaped, so this can not get out of sync
+      if (c == '"')
+        _in_string = !_in_string;
+      else if (!_in_string && c == '!')
+        _in_slot = true;
+      else if (!_in_string && c == 'x' && _prev[0] == '<' && _prev[1] == '0')
+        _in_address = true;
+
+      _prev[0] = _prev[1];
+      _prev[1] = c;
+
+      buf.push_back(c);
+    }
+
+    _md5.update(buf.str());
+    _pos += size;
+  }
+
+  uint64_t current_pos() const override {
+    return _pos;
+  }
+
+  MD5&     _md5;
+  uint64_t _pos        = 0;
+  char     _prev[2]    = {0, 0};
+  bool     _in_string  = false;
+  bool     _in_slot    = false;
+  bool     _in_address = false;
+};
+
+/// Prints everything that affects the HTML rendered for a function to a HashStream.
+struct KeyBuilder {
+  KeyBuilder(raw_ostream& OS, ModuleSlotTracker& slots, ValueNameMangler& names)
+  : OS{OS}
+  , _slots{slots}
+  , _names{names}
+  {}
+
+  void addFunction(const Function& fn) {
+    _module = fn.getParent();
+    _slots.incorporateFunction(fn);
+
+    fn.printAsOperand(OS, true, _slots);
+    OS << ' ';
+    _names.getId(&fn, OS); // numeric IDs depend on where the function is in the module
+    OS << '\n';
+
+    for (auto& arg : fn.args()) {
+      arg.printAsOperand(OS, true, _slots);
+      OS << '\n';
+    }
+
+    for (auto& bb : fn) {
+      bb.printAsOperand(OS, false, _slots);
+      OS << ":\n";
+
+      for (auto& inst : bb)
+        addInstruction(inst);
+    }
+
+    /// whether a global is rendered as link depends on whether its definition is part of the output.
+    for (auto glbl : _globals) {
+      glbl->printAsOperand(OS, false, _slots);
+      OS << ' ';
+      _names.getId(glbl, OS);
+      OS << (_names.isDefinition(glbl) ? " link\n" : " text\n");
+    }
+  }
+private:
+  void addInstruction(const Instruction& inst) {
+    inst.print(OS, _slots);
+    OS << '\n';
+
+    for (auto& op : inst.operands()) {
+      if (auto md = dyn_cast<MetadataAsValue>(op))
+        addMetadata(md->getMetadata());
+      else
+        addGlobal(op);
+    }
+
+    SmallVector<std::pair<unsigned, MDNode*>, 4> mds;
+    inst.getAllMetadata(mds);
+
+    for (auto& md : mds)
+      addMetadata(md.second);
+  }
+
+  void addMetadata(const Metadata* md) {
+    if (!md) {
+      OS << "null\n";
+      return;
+    }
+
+    /// metadata may be shared and even cyclic, so every node is only hashed once and then referred to by position.
+    auto it = _metadata.insert({md, _metadata.size()});
+    if (!it.second) {
+      OS << '#' << it.first->second << '\n';
+      return;
+    }
+
+    md->print(OS, _slots, _module);
+    OS << '\n';
+
+    if (auto val = dyn_cast<ValueAsMetadata>(md))
+      addGlobal(val->getValue());
+
+    if (auto node = dyn_cast<MDNode>(md)) {
+      for (auto& op : node->operands())
+        addMetadata(op);
+    }
+  }
+
+  void addGlobal(const Value* v) {
+    if (auto glbl = dyn_cast<GlobalValue>(v))
+      _globals.insert(glbl);
+  }
+
+  raw_ostream&       OS;
+  ModuleSlotTracker& _slots;
+  ValueNameMangler&  _names;
+  const Module*      _module = nullptr;
+
+  DenseMap<const Metadata*, unsigned> _metadata;
+  SetVector<const GlobalValue*>       _globals;
+};
+
+} // end anonymous namespace
+
+RenderCache::RenderCache(StringRef dir, StringRef config)
+: _dir{dir}
+, _config{config}
+{
+  if (auto EC = sys::fs::create_directories(dir)) {
+    errs() << "llvm-viz: Could not create cache directory `" << dir << "': " << EC.message() << '\n';
+    exit(1);
+  }
+}
+
+std::string html::hashFunction(const Function& fn, const Twine& config, unsigned indent, ModuleSlotTracker& slots, ValueNameMangler& names) {
+  assert(!fn.isMaterializable());
+
+  MD5 md5;
+  {
+    HashStream OS{md5};
+
+    OS << "llvm-viz " << FORMAT_VERSION << ", LLVM " << LLVM_VERSION_STRING << '\n';
+    OS << config << '\n';
+    OS << "indent " << indent << '\n';
+
+    const Module& m = *fn.getParent();
+    OS << m.getDataLayoutStr() << '\n';
+    OS << m.getTargetTriple() << '\n';
+
+    KeyBuilder{OS, slots, names}.addFunction(fn);
+  }
+
+  MD5::MD5Result result;
+  md5.final(result);
+
+  SmallString<32> hex;
+  MD5::stringifyResult(result, hex);
+  return std::string(hex.begin(), hex.end());
+}
+
+bool RenderCache::lookup(StringRef key, raw_ostream& OS) const {
+  auto buf = MemoryBuffer::getFile(path(key));
+  if (!buf)
+    return false;
+
+  OS << (*buf)->getBuffer();
+  return true;
+}
+
+void RenderCache::store(StringRef key, StringRef html) const {
+  /// Write to a temporary file first and move it into place once complete,
+  /// so other threads or processes using the same cache never see half written fragments.
+  int fd;
+  SmallString<128> tmp;
+
+  if (auto EC = sys::fs::createUniqueFile(_dir + "/tmp-%%%%%%%%", fd, tmp)) {
+    errs() << "llvm-viz: Could not write to cache directory `" << _dir << "': " << EC.message() << '\n';
+    return;
+  }
+
+  {
+    raw_fd_ostream OS{fd, true};
+    OS << html;
+    OS.close();
+
+    if (OS.has_error()) {
+      OS.clear_error();
+      sys::fs::remove(tmp);
+      return;
+    }
+  }
+
+  if (auto EC = sys::fs::rename(tmp, path(key))) {
+    errs() << "llvm-viz: Could not write to cache directory `" << _dir << "': " << EC.message() << '\n';
+    sys::fs::remove(tmp);
+  }
+}
+
+std::string RenderCache::path(StringRef key) const {
+  SmallString<128> path{_dir};
+  sys::path::append(path, key + ".html");
+  return std::string(path.begin(), path.end());
+}
@@ -0,0 +1,64 @@
+// This file is distributed under the Revised BSD Open Source License.
+// See LICENSE.TXT for details.
+
+#pragma once
+
+#include <llvm/ADT/StringRef.h>
+#include <llvm/ADT/Twine.h>
+#include <string>
+
+namespace llvm {
+  class Function;
+  class ModuleSlotTracker;
+  class raw_ostream;
+}
+
+namespace html {
+
+struct ValueNameMangler;
+
+using namespace llvm;
+
+/// Structural hash of everything that goes into rendering the HTML for @p fn printed at the given indent.
+/// The body of @p fn has to be materialized.
+/// @param config  describes all settings of the current run that affect how functions are rendered,
+///                plus anything else rendering @p fn reads, like source files
+std::string hashFunction(const Function& fn, const Twine& config, unsigned indent, ModuleSlotTracker& slots, ValueNameMangler& names);
+
+/***
+ * Content addressed on-disk cache for the HTML of rendered functions.
+ *
+ * Every fragment is stored under a hash of everything that goes into rendering it:
+ * the function body & metadata it references, the globals it links to, the tool version and how it is configured.
+ * Fragments can be shared between runs on different versions of a module, as long as the function did not change.
+ *
+ * The cache never evicts anything, it is up to the user to clear the directory.
+ * All methods are thread safe.
+ */
+struct RenderCache {
+  /// @param dir     directory with the cached fragments, created if it does not exist yet
+  /// @param config  describes all settings of the current run that affect how functions are rendered
+  RenderCache(StringRef dir, StringRef config);
+
+  /// Computes the key for the HTML of @p fn printed at the given indent, see hashFunction().
+  /// @param inputs  describes everything besides @p fn that rendering it reads, see Renderer::describeInputs()
+  std::string key(const Function& fn, unsigned indent, ModuleSlotTracker& slots, ValueNameMangler& names,
+                  StringRef inputs) const {
+    return hashFunction(fn, Twine(_config) + "\n" + inputs, indent, slots, names);
+  }
+
+  /// Prints the fragment stored under @p key to @p OS.
+  /// Returns false, without printing anything, if there is none.
+  bool lookup(StringRef key, raw_ostream& OS) const;
+
+  /// Stores @p html under @p key.
+  /// Failing to write the cache is not an error, the fragment just is not cached then.
+  void store(StringRef key, StringRef html) const;
+private:
+  std::string path(StringRef key) const;
+
+  std::string _dir;
+  std::string _config;
+};
+
+} // end namespace html
@@ -0,0 +1,69 @@
+// This file is distributed under the Revised BSD Open Source License.
+// See LICENSE.TXT for details.
+
+#include "SourceIndex.hpp"
+#include <llvm/ADT/SmallString.h>
+#include <llvm/Support/MD5.h>
+
+using namespace html;
+using namespace llvm;
+
+const SourceIndex::File* SourceIndex::file(StringRef path) {
+  std::lock_guard<std::mutex> lock{_mutex};
+
+  auto it = _files.find(path);
+  if (it != _files.end())
+    return it->second.get();
+
+  auto& entry = _files[path];
+
+  /// large files are mmap'ed, we never need a null terminator
+  auto buf = MemoryBuffer::getFile(path, -1, false);
+  if (!buf)
+    return nullptr;
+
+  entry.reset(new File);
+  entry->buffer = std::move(*buf);
+
+  StringRef text = entry->buffer->getBuffer();
+
+  entry->lines.push_back(0);
+  for (size_t pos = text.find('\n'); pos != StringRef::npos; pos = text.find('\n', pos + 1))
+    entry->lines.push_back(pos + 1);
+
+  MD5 md5;
+  md5.update(text);
+
+  MD5::MD5Result result;
+  md5.final(result);
+
+  SmallString<32> hex;
+  MD5::stringifyResult(result, hex);
+  entry->digest = std::string(hex.begin(), hex.end());
+
+  return entry.get();
+}
+
+Optional<StringRef> SourceIndex::line(StringRef path, unsigned line) {
+  auto file = this->file(path);
+
+  if (!file || !line || (line > file->lines.size()))
+    return None;
+
+  StringRef text = file->buffer->getBuffer();
+
+  size_t start = file->lines[line - 1];
+  size_t end   = (line < file->lines.size()) ? file->lines[line] : text.size();
+
+  /// a trailing line break does not start another line
+  if ((start == end) && (line == file->lines.size()))
+    return None;
+
+  return text.slice(start, end).rtrim("\r\n");
+}
+
+std::string SourceIndex::digest(StringRef path) {
+  auto file = this->file(path);
+
+  return file ? file->digest : "missing";
+}
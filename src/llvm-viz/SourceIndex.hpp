@@ -0,0 +1,47 @@
+// This file is distributed under the Revised BSD Open Source License.
+// See LICENSE.TXT for details.
+
+#pragma once
+
+#include <llvm/ADT/Optional.h>
+#include <llvm/ADT/StringMap.h>
+#include <llvm/ADT/StringRef.h>
+#include <llvm/Support/MemoryBuffer.h>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace html {
+
+using namespace llvm;
+
+/***
+ * Source files referenced by debug info, split into lines.
+ *
+ * A file is only read when it is first asked about, then it stays mapped into memory and its lines are indexed,
+ * so looking up a line afterwards is cheap.
+ * All methods are thread safe.
+ */
+struct SourceIndex {
+  /// Text of line @p line (counting from 1) of file @p path, without the line break.
+  /// None if the file can not be read or is shorter.
+  Optional<StringRef> line(StringRef path, unsigned line);
+
+  /// Hash of the contents of file @p path, for noticing when it changed.
+  std::string digest(StringRef path);
+private:
+  struct File {
+    std::unique_ptr<MemoryBuffer> buffer;
+    std::vector<uint32_t>         lines; // offset of the start of every line
+    std::string                   digest;
+  };
+
+  /// Loads & indexes the file on first use, nullptr if it can not be read.
+  const File* file(StringRef path);
+
+  std::mutex                       _mutex;
+  StringMap<std::unique_ptr<File>> _files; // nullptr for files that can not be read
+};
+
+} // end namespace html
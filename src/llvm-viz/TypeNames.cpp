@@ -0,0 +1,104 @@
+// This file is distributed under the Revised BSD Open Source License.
+// See LICENSE.TXT for details.
+
+#include "TypeNames.hpp"
+#include "HtmlUtils.hpp"
+#include <llvm/ADT/SmallString.h>
+#include <llvm/IR/Type.h>
+#include <llvm/Support/raw_ostream.h>
+
+using namespace html;
+using namespace llvm;
+
+static StringRef save(BumpPtrAllocator& alloc, StringRef str) {
+  auto mem = static_cast<char*>(alloc.Allocate(str.size(), 1));
+  std::copy(str.begin(), str.end(), mem);
+  return StringRef{mem, str.size()};
+}
+
+TypeNames::Entry& TypeNames::lookup(const Type* ty) {
+  assert(ty);
+
+  auto& entry = _entries[ty];
+
+  if (entry.name.data())
+    return entry;
+
+  SmallString<64> buf;
+  raw_svector_ostream{buf} << *ty;
+  entry.name = save(_alloc, buf);
+
+  SmallString<64> escaped;
+  {
+    raw_svector_ostream OS{escaped};
+    print_str(OS, entry.name);
+  }
+  entry.escaped = (escaped == entry.name) ? entry.name : save(_alloc, escaped);
+
+  entry.function = 0;
+  return entry;
+}
+
+unsigned TypeNames::indexOf(Entry& entry) {
+  if (entry.function != _function) {
+    entry.function = _function;
+    entry.index    = _table.size();
+
+    _table.push_back(entry.name);
+  }
+  return entry.index;
+}
+
+HtmlAttr TypeNames::titleAttr(const Type* ty) {
+  auto& entry = lookup(ty);
+
+  if (entry.escaped.size() <= MAX_INLINE_LENGTH)
+    return attr("title", entry.escaped);
+  else
+    return data_attr("ty", Twine(indexOf(entry)));
+}
+
+void TypeNames::printTitleAttr(const Type* ty, raw_ostream& OS) {
+  auto& entry = lookup(ty);
+
+  if (entry.escaped.size() <= MAX_INLINE_LENGTH)
+    OS << " title=\"" << entry.escaped << '"';
+  else
+    OS << " data-ty=\"" << indexOf(entry) << '"';
+}
+
+void TypeNames::beginFunction() {
+  _function++;
+  _table.clear();
+}
+
+std::string TypeNames::functionTable() const {
+  if (_table.empty())
+    return {};
+
+  std::string json;
+  raw_string_ostream JS{json};
+
+  JS << '[';
+  for (size_t i = 0; i < _table.size(); i++) {
+    if (i)
+      JS << ',';
+
+    JS << '"';
+    for (char c : _table[i]) {
+      if ((c == '"') || (c == '\\'))
+        JS << '\\';
+      JS << c;
+    }
+    JS << '"';
+  }
+  JS << ']';
+  JS.flush();
+
+  std::string str;
+  raw_string_ostream OS{str};
+  print_str(OS, json);
+  OS.flush();
+
+  return str;
+}
@@ -0,0 +1,73 @@
+// This file is distributed under the Revised BSD Open Source License.
+// See LICENSE.TXT for details.
+
+#pragma once
+
+#include <llvm/ADT/DenseMap.h>
+#include <llvm/ADT/StringRef.h>
+#include <llvm/Support/Allocator.h>
+#include <string>
+#include <vector>
+
+namespace llvm {
+  class Type;
+  class raw_ostream;
+}
+
+namespace html {
+
+struct HtmlAttr;
+
+using namespace llvm;
+
+/***
+ * Interned printed names of LLVM types.
+ *
+ * Types are uniqued per context, so every type is only printed once no matter how many values have it.
+ *
+ * Long type names are not repeated in the mouseover text of every value of that type,
+ * values refer to the type by a short index into a table of the function they are in instead (see functionTable()).
+ * The indices only depend on the function itself, so a function is rendered the same no matter what was rendered before.
+ */
+struct TypeNames {
+  /// Type names up to this length are used as mouseover text directly.
+  static constexpr const size_t MAX_INLINE_LENGTH = 24;
+
+  /// Printed name of @p ty, like `%struct.foo*'. Stays valid as long as the table does.
+  StringRef name(const Type* ty) {
+    return lookup(ty).name;
+  }
+
+  /// Attribute for the mouseover text of a value of type @p ty, either `title' or `data-ty' with an index.
+  HtmlAttr titleAttr(const Type* ty);
+
+  /// Prints the same attribute as titleAttr(), with a leading space.
+  void printTitleAttr(const Type* ty, raw_ostream& OS);
+
+  /// Start a new function, indices handed out before refer to the table of the previous one.
+  void beginFunction();
+
+  /// Names of the types referred to by index since beginFunction(), as a JSON array for the `data-types' attribute.
+  /// Empty if there are none.
+  std::string functionTable() const;
+private:
+  struct Entry {
+    StringRef name;
+    StringRef escaped;  // name with HTML special chars escaped, for attributes
+    unsigned  function; // the function `index' belongs to, see _function
+    unsigned  index;
+  };
+
+  Entry& lookup(const Type* ty);
+
+  /// index of @p entry in the table of the current function, added if it is not in there yet
+  unsigned indexOf(Entry& entry);
+
+  BumpPtrAllocator             _alloc;
+  DenseMap<const Type*, Entry> _entries;
+
+  unsigned               _function = 1; // entries with another function have no index yet
+  std::vector<StringRef> _table;        // names of types in the table of the current function
+};
+
+} // end namespace html
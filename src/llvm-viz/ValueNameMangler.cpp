@@ -7,27 +7,152 @@
 #include <llvm/PassRegistry.h>
 #include <llvm/IR/BasicBlock.h>
 #include <llvm/IR/Function.h>
+#include <llvm/IR/Module.h>
+#include <llvm/Support/MD5.h>
 #include <support/PrintUtils.hpp>
 
 using namespace html;
 using namespace llvm;
 
+static StringRef save(BumpPtrAllocator& alloc, StringRef str) {
+  auto mem = static_cast<char*>(alloc.Allocate(str.size(), 1));
+  std::copy(str.begin(), str.end(), mem);
+  return StringRef{mem, str.size()};
+}
+
 std::string ValueNameMangler::getId(const Value *v) {
   assert(v);
 
+  if (_numeric) {
+    std::string id;
+    raw_string_ostream OS{id};
+    printNumericId(v, OS);
+    return OS.str();
+  }
+
+  return mangledName(v);
+}
+
+void ValueNameMangler::getId(const Value *v, raw_ostream &OS) {
+  assert(v);
+
+  if (_numeric)
+    printNumericId(v, OS);
+  else
+    OS << mangledName(v);
+}
+
+const std::string& ValueNameMangler::mangledName(const Value *v) {
   assert(!_ids.count(v) || !_ids[v].empty());
   auto& id = _ids[v];
 
   if (id.empty()) {
     raw_string_ostream OS{id};
-    getId(v, OS);
+    mangleName(v, OS);
     OS.flush();
   }
 
   return id;
 }
 
-void ValueNameMangler::getId(const Value *v, raw_ostream &OS) {
+void ValueNameMangler::printNumericId(const Value *v, raw_ostream &OS) {
+  if (auto fn = dyn_cast<Function>(v)) {
+    OS << 'f' << globalOrdinal(fn);
+  } else if (auto glbl = dyn_cast<GlobalValue>(v)) {
+    OS << 'g' << globalOrdinal(glbl);
+  } else if (auto arg = dyn_cast<Argument>(v)) {
+    printNumericId(arg->getParent(), OS);
+    OS << 'a' << arg->getArgNo();
+  } else if (auto bb = dyn_cast<BasicBlock>(v)) {
+    printNumericId(bb->getParent(), OS);
+    OS << 'b' << localOrdinal(bb);
+  } else if (auto inst = dyn_cast<Instruction>(v)) {
+    printNumericId(inst->getParent(), OS);
+    OS << 'i' << localOrdinal(inst);
+  } else {
+    llvm_unreachable("Invalid Value kind");
+  }
+}
+
+unsigned ValueNameMangler::globalOrdinal(const GlobalValue *v) {
+  if (_global_ordinals.empty()) {
+    auto& m = *v->getParent();
+
+    unsigned num_functions = 0;
+    for (auto& fn : m)
+      _global_ordinals[&fn] = num_functions++;
+
+    unsigned num_globals = 0;
+    for (auto& glbl : m.globals())
+      _global_ordinals[&glbl] = num_globals++;
+    for (auto& alias : m.aliases())
+      _global_ordinals[&alias] = num_globals++;
+    for (auto& ifunc : m.ifuncs())
+      _global_ordinals[&ifunc] = num_globals++;
+  }
+
+  assert(_global_ordinals.count(v));
+  return _global_ordinals.lookup(v);
+}
+
+unsigned ValueNameMangler::localOrdinal(const Value *v) {
+  auto fn = isa<BasicBlock>(v) ? cast<BasicBlock>(v)->getParent() : cast<Instruction>(v)->getFunction();
+
+  nameFunction(*fn);
+
+  assert(_locals.count(v));
+  return _locals.find(v)->second.ordinal;
+}
+
+void ValueNameMangler::nameFunction(const Function& fn) {
+  if (&fn == _current_function)
+    return;
+
+  _locals.clear();
+  _local_alloc.Reset();
+  _current_function = &fn;
+
+  SmallString<32> buf;
+
+  auto add = [&](const Value& v, unsigned ordinal) {
+    StringRef name;
+
+    if (!v.getType()->isVoidTy()) {
+      buf.clear();
+      raw_svector_ostream OS{buf};
+      v.printAsOperand(OS, false, _slots);
+
+      name = save(_local_alloc, buf);
+    }
+
+    _locals[&v] = Local{name, ordinal};
+  };
+
+  for (auto& arg : fn.args())
+    add(arg, arg.getArgNo());
+
+  unsigned num_blocks = 0;
+  for (auto& bb : fn) {
+    add(bb, num_blocks++);
+
+    unsigned num_insts = 0;
+    for (auto& inst : bb)
+      add(inst, num_insts++);
+  }
+}
+
+void ValueNameMangler::markBodyDropped(const Function& fn) {
+  _dropped_bodies.insert(&fn);
+
+  /// the blocks & instructions we named are gone
+  if (&fn == _current_function) {
+    _locals.clear();
+    _local_alloc.Reset();
+    _current_function = nullptr;
+  }
+}
+
+void ValueNameMangler::mangleName(const Value *v, raw_ostream &OS) {
   assert(v);
   assert(!isa<Constant>(v) || isa<GlobalValue>(v));
 
@@ -41,19 +166,19 @@ void ValueNameMangler::getId(const Value *v, raw_ostream &OS) {
   {
     raw_svector_ostream OS{buf};
     if (isa<GlobalValue>(v)) {
-      v->printAsOperand(OS, false, _slots);
+      OS << asOperand(v);
     } else if (auto bb = dyn_cast<BasicBlock>(v)) {
       OS << bb->getParent()->getName();
       OS << '.';
-      v->printAsOperand(OS, false, _slots);
+      OS << asOperand(v);
     } else if (auto inst = dyn_cast<Instruction>(v)) {
       OS << inst->getFunction()->getName();
       OS << '.';
-      v->printAsOperand(OS, false, _slots);
+      OS << asOperand(v);
     } else if (auto arg = dyn_cast<Argument>(v)) {
       OS << arg->getParent()->getName();
       OS << '.';
-      v->printAsOperand(OS, false, _slots);
+      OS << asOperand(v);
     } else {
       llvm_unreachable("Invalid Value kind");
     }
@@ -109,22 +234,63 @@ void ValueNameMangler::getId(const Value *v, raw_ostream &OS) {
 
 void ValueNameMangler::asOperand(const Value *v, raw_ostream& OS) {
   assert(v);
-  v->printAsOperand(OS, false, _slots);
+
+  StringRef name = lookupName(v);
+
+  if (!name.empty())
+    OS << name;
+  else
+    v->printAsOperand(OS, false, _slots);
 }
 
-std::string ValueNameMangler::asOperand(const Value &v) {
-  std::string str;
-  raw_string_ostream OS{str};
+StringRef ValueNameMangler::asOperand(const Value &v) {
+  StringRef name = lookupName(&v);
 
-  asOperand(v, OS);
-  OS.flush();
+  if (!name.empty())
+    return name;
 
-  return str;
+  _scratch.clear();
+  raw_string_ostream OS{_scratch};
+  v.printAsOperand(OS, false, _slots);
+  return OS.str();
+}
+
+StringRef ValueNameMangler::lookupName(const Value *v) {
+  if (auto glbl = dyn_cast<GlobalValue>(v)) {
+    auto& name = _global_names[glbl];
+
+    if (name.empty()) {
+      SmallString<32> buf;
+      raw_svector_ostream OS{buf};
+      glbl->printAsOperand(OS, false, _slots);
+
+      name = save(_global_alloc, buf);
+    }
+    return name;
+  }
+
+  if (isa<Constant>(v))
+    return {};
+
+  auto it = _locals.find(v);
+  return (it != _locals.end()) ? it->second.name : StringRef{};
+}
+
+bool ValueNameMangler::isDefinition(const GlobalValue* v) {
+  if (auto fn = dyn_cast<Function>(v)) {
+    if (_not_rendered.count(fn))
+      return false;
+    if (_dropped_bodies.count(fn))
+      return true;
+  }
+
+  /// functions that are not materialized yet are not declarations either
+  return !v->isDeclaration();
 }
 
 Html* ValueNameMangler::ref(const Value* v) {
   if (auto glbl = dyn_cast<GlobalValue>(v)) {
-    if (glbl->isDeclaration()) {
+    if (!isDefinition(glbl)) {
       return makeString(v);
     } else {
       return makeLink(v);
@@ -136,12 +302,76 @@ Html* ValueNameMangler::ref(const Value* v) {
   }
 }
 
+void ValueNameMangler::printRef(const Value* v, raw_ostream& OS) {
+  bool link;
+  if (auto glbl = dyn_cast<GlobalValue>(v))
+    link = isDefinition(glbl);
+  else
+    link = !isa<Constant>(v);
+
+  if (link) {
+    OS << "<a href=\"";
+    if (_sharded) {
+      if (auto fn = dyn_cast<Function>(v))
+        OS << shardFileName(*fn);
+    }
+    OS << '#';
+    getId(v, OS);
+    OS << '"';
+  } else {
+    OS << "<span";
+  }
+
+  /// add type of value as mouseover text
+  _types.printTitleAttr(v->getType(), OS);
+  OS << '>';
+
+  print_str(OS, asOperand(v));
+
+  OS << (link ? "</a>" : "</span>");
+}
+
+std::string ValueNameMangler::shardFileName(const Function& fn) {
+  /// mangled C++ names can get *very* long, so cut off long names and add a hash to keep them unique.
+  static constexpr const size_t MAX_LENGTH = 128;
+
+  /// always use the name, so files keep their names when other functions are added or removed
+  std::string name = mangledName(&fn);
+
+  if (name.size() > MAX_LENGTH) {
+    MD5 hash;
+    hash.update(name);
+
+    MD5::MD5Result result;
+    hash.final(result);
+
+    SmallString<32> hex;
+    MD5::stringifyResult(result, hex);
+
+    name.resize(MAX_LENGTH - hex.size() - 1);
+    name += '_';
+    name += hex.str();
+  }
+
+  return name + ".html";
+}
+
 Html* ValueNameMangler::makeLink(const Value *v) {
+  std::string href;
+
+  if (_sharded) {
+    if (auto fn = dyn_cast<Function>(v))
+      href = shardFileName(*fn);
+  }
+
+  href += '#';
+  href += getId(v);
+
   return tag(
     "a",
-    attr("href",  '#' + getId(v)),
+    attr("href",  href),
     /// add type of value as mouseover text
-    attr("title", print(*v->getType(), false)),
+    _types.titleAttr(v->getType()),
     asOperand(v)
   );
 }
@@ -149,7 +379,7 @@ Html* ValueNameMangler::makeLink(const Value *v) {
 Html* ValueNameMangler::makeString(const Value *v) {
   return html::span(
     /// add type of value as mouseover text
-    attr("title", print(*v->getType(), false)),
+    _types.titleAttr(v->getType()),
     asOperand(v)
   );
 }
@@ -4,8 +4,11 @@
 
 #pragma once
 
+#include <llvm/ADT/DenseSet.h>
 #include <llvm/IR/ModuleSlotTracker.h>
 #include <llvm/IR/ValueMap.h>
+#include <llvm/Support/Allocator.h>
+#include "TypeNames.hpp"
 
 namespace html {
 
@@ -30,8 +33,10 @@ struct ValueNameMangler {
   }
   void getId(const Value* v, raw_ostream& OS);
 
-  std::string asOperand(const Value& v);
-  std::string asOperand(const Value* v) {
+  /// Printed operand of @p v, like `%x', `@foo' or `42'.
+  /// Only stays valid until the next call of asOperand() or nameFunction().
+  StringRef asOperand(const Value& v);
+  StringRef asOperand(const Value* v) {
     assert(v);
     return asOperand(*v);
   }
@@ -41,18 +46,80 @@ struct ValueNameMangler {
     asOperand(&v, OS);
   }
 
+  /// Name of the HTML file the given function is printed to when every function gets its own page.
+  /// Only contains chars that are valid in IDs and is short enough for any file system.
+  std::string shardFileName(const Function& fn);
+
+  /// If set, links to functions point to the page of the function (see shardFileName()) instead of into the current page.
+  void setShardedOutput(bool sharded) { _sharded = sharded; }
+
+  /// Prints the operand names of all arguments, blocks and instructions of @p fn once,
+  /// from then on asOperand() and getId() just look them up. Replaces the table of the previous function.
+  void nameFunction(const Function& fn);
+
+  /// If set, IDs are built from the positions of values in the module, like `f12b3i45' for an instruction, instead of their names.
+  /// They are much shorter and cost no memory, but change whenever something is inserted in front of a value.
+  void setNumericIds(bool numeric) { _numeric = numeric; }
+
+  /// Called after the body of a lazily loaded function was deleted again once it has been rendered.
+  /// The function is still treated as a definition, i.e., we still create links to it.
+  void markBodyDropped(const Function& fn);
+
+  /// Called for functions that are left out of the output, links to them would lead nowhere.
+  void markNotRendered(const Function& fn) { _not_rendered.insert(&fn); }
+
   /// Creates a <a href="#..."> tag or simple string for the given value.
   /// Constants and external globals are rendered as a simple string, for other values a link is created.
   Html* ref(const Value* v);
   Html* ref(const Value& v) {
     return ref(&v);
   }
+
+  /// Prints the same HTML as ref() in flow style, without creating any DOM nodes.
+  void printRef(const Value* v, raw_ostream& OS);
+
+  /// Printed names of types, shared by everything rendered with this mangler.
+  TypeNames& types() { return _types; }
+
+  /// Does the output contain a definition for @p v, even if its body is currently not loaded.
+  /// References to definitions are rendered as links by ref().
+  bool isDefinition(const GlobalValue* v);
 private:
+  /// name based ID of @p v, cached.
+  const std::string& mangledName(const Value* v);
+  void mangleName(const Value* v, raw_ostream& OS);
+
+  /// operand name of a global or of a local of the current function, empty if we have none.
+  StringRef lookupName(const Value* v);
+
+  void printNumericId(const Value* v, raw_ostream& OS);
+  unsigned globalOrdinal(const GlobalValue* v);
+  unsigned localOrdinal(const Value* v);
+
   Html* makeLink(const Value* v);
   Html* makeString(const Value* v);
 
   ModuleSlotTracker& _slots;
-  ValueMap<const Value*, std::string> _ids;
+  TypeNames _types;
+  ValueMap<const Value*, std::string> _ids; // see mangledName()
+  bool _numeric = false;
+  DenseMap<const GlobalValue*, unsigned> _global_ordinals; // position in the function or global list of the module
+
+  /// ***** operand names, see nameFunction()
+  struct Local {
+    StringRef name;    // empty for values without a name, like void instructions
+    unsigned  ordinal; // position of an argument in its function, of a block in its function or of an instruction in its block
+  };
+
+  BumpPtrAllocator _global_alloc;
+  DenseMap<const GlobalValue*, StringRef> _global_names;
+  BumpPtrAllocator _local_alloc;
+  DenseMap<const Value*, Local> _locals;   // locals of _current_function
+  const Function* _current_function = nullptr;
+  std::string _scratch;                    // names that are not in any table
+  bool _sharded = false;
+  DenseSet<const Function*> _dropped_bodies;
+  DenseSet<const Function*> _not_rendered;
 };
 
 } // end namespace html
@@ -1,6 +1,9 @@
 // This file is distributed under the Revised BSD Open Source License.
 // See LICENSE.TXT for details.
 
+#include <llvm/ADT/SmallPtrSet.h>
+#include <llvm/ADT/StringMap.h>
+#include <llvm/ADT/StringExtras.h>
 #include <llvm/ADT/StringRef.h>
 #include <llvm/ADT/Twine.h>                 // for Twine
 #include <llvm/Analysis/AliasAnalysis.h>
@@ -9,6 +12,8 @@
 #include <llvm/Analysis/ScalarEvolution.h>
 #include <llvm/Analysis/ScalarEvolutionExpressions.h>
 #include <llvm/Analysis/TargetLibraryInfo.h>
+#include <llvm/IR/CFG.h>
+#include <llvm/IR/DebugInfoMetadata.h>
 #include <llvm/IR/Dominators.h>
 #include <llvm/IR/LLVMContext.h>            // for getGlobalContext
 #include <llvm/IR/LegacyPassManager.h>      // for PassManager
@@ -21,20 +26,41 @@
 #include <llvm/PassRegistry.h>              // for PassRegistry
 #include <llvm/PassSupport.h>               // for INITIALIZE_PASS
 #include <llvm/Support/CommandLine.h>       // for desc, ParseCommandLineOptions, opt, value_desc, FormattingFlags::Positional
+#include <llvm/Support/Compression.h>
+#include <llvm/Support/Error.h>
 #include <llvm/Support/FileSystem.h>
+#include <llvm/Support/MD5.h>
+#include <llvm/Support/MemoryBuffer.h>
+#include <llvm/Support/Path.h>
 #include <llvm/Support/PrettyStackTrace.h>  // for PrettyStackTraceProgram
 #include <llvm/Support/raw_ostream.h>       // for raw_ostream, outs
 #include <llvm/Support/Signals.h>           // for PrintStackTraceOnErrorSignal
 #include <llvm/Support/SourceMgr.h>
+#include <llvm/Support/ThreadPool.h>
+#include <llvm/Support/Threading.h>
 #include <llvm/Support/ToolOutputFile.h>
+#include <array>
+#include <atomic>
+#include <condition_variable>
 #include <memory>                           // for unique_ptr
+#include <mutex>
+#include <set>
 #include <string>                           // for string
+#include <thread>
 #include "HtmlUtils.hpp"
 #include "ValueNameMangler.hpp"
 #include "CfgToDot.hpp"
+#include "FileWatcher.hpp"
+#include "FunctionSelector.hpp"
+#include "HttpServer.hpp"
+#include "RenderCache.hpp"
+#include "SourceIndex.hpp"
 #include "Style.hpp"
+#include <support/GzipStream.hpp>
+#include <support/LruCache.hpp>
 #include <support/VectorAppender.hpp>
 #include <support/safe_ptr.hpp>
+#include <support/TimeTrace.hpp>
 #include <support/VectorAppender.hpp>
 #include <support/PrintUtils.hpp>
 
@@ -46,35 +72,152 @@
 using namespace llvm;
 using namespace html;
 
+/// File names of shared libraries when they are not inlined into the page
+static const char JQueryFile[]       = "jquery-2.2.1.min.js";
+static const char BootstrapJsFile[]  = "bootstrap.min.js";
+static const char BootstrapCssFile[] = "bootstrap.min.css";
+
+/// JS & CSS frameworks every page uses
+struct Asset {
+  const char* file; // name in output directories
+  StringRef (*source)();
+};
+static const Asset Assets[] = {
+  {JQueryFile,       jQuerySource},
+  {BootstrapJsFile,  BootstrapJsSource},
+  {BootstrapCssFile, BootstrapCssSource},
+};
+
 static cl::opt<std::string> InputFilename(cl::Positional, cl::desc("<IR file>"));
 static cl::opt<std::string> OutputFilename("o", cl::desc("Output filename"), cl::value_desc("filename"));
+static cl::opt<std::string> OutputDirectory("o-dir",
+                                            cl::desc("Write one HTML page per function and an index page to a directory"),
+                                            cl::value_desc("directory"));
+static cl::opt<unsigned> NumThreads("j",
+                                    cl::desc("Number of threads used for rendering functions (0 = one per core)"),
+                                    cl::value_desc("N"),
+                                    cl::init(1));
+static cl::list<std::string> Columns("columns",
+                                     cl::desc("Only render these columns of the instruction table, "
+                                              "out of name,type,opcode,operands,location,scev,metadata (default: all)"),
+                                     cl::value_desc("column,..."),
+                                     cl::CommaSeparated);
+static cl::opt<bool> NumericIds("numeric-ids",
+                                cl::desc("Use short IDs based on the position of values in the module instead of their names"));
+static cl::opt<bool> ShowSource("source",
+                                cl::desc("Show the source code instructions come from next to every function, "
+                                         "read from the files named in their debug locations"));
+static cl::opt<bool> Compress("compress",
+                              cl::desc("Gzip compress the output, on multiple threads if -j is given. "
+                                       "Implied by -o files ending in .gz, with -o-dir every file gets a .gz suffix"));
+static cl::opt<bool> Compact("compact",
+                             cl::desc("Leave out all indentation and line breaks between tags, for smaller output"));
+static cl::opt<bool> GzipAssets("gzip-assets",
+                                cl::desc("Embed jQuery & Bootstrap gzip compressed in single page output, "
+                                         "the page only works in browsers that support DecompressionStream"));
+static cl::opt<std::string> AssetDirectory("asset-dir",
+                                           cl::desc("Write jQuery & Bootstrap to this directory once, under names containing "
+                                                    "a hash of their contents, and link pages to them instead of embedding them"),
+                                           cl::value_desc("directory"));
+static cl::opt<std::string> AssetUrl("asset-url",
+                                     cl::desc("URL pages use for the -asset-dir directory (default: the directory as given)"),
+                                     cl::value_desc("url"));
+static cl::opt<std::string> TimeTraceFile("time-trace",
+  cl::desc("Write how long the phases of the run, every function and every column took to a file, "
+           "in the Chrome trace event format (see chrome://tracing)"),
+  cl::value_desc("filename"));
+static cl::opt<unsigned> TimeTraceGranularity("time-trace-granularity",
+  cl::desc("Leave spans shorter than this many microseconds out of the -time-trace file (default: 500)"),
+  cl::init(500));
+static cl::opt<bool> TimeReport("time-report",
+  cl::desc("Print a table of where the time of the run went to stderr"));
+static cl::opt<std::string> CacheDirectory("cache-dir",
+                                           cl::desc("Reuse the HTML of functions that did not change since an earlier run"),
+                                           cl::value_desc("directory"));
+static cl::opt<bool> Watch("watch",
+                           cl::desc("Keep running and update the output directory whenever the input file changes"));
+static cl::opt<std::string> ServeAddress("serve",
+                                         cl::desc("Serve the module over HTTP on localhost, functions are rendered on demand"),
+                                         cl::value_desc("[localhost]:port"));
+static cl::opt<unsigned> ServeCacheSize("serve-cache-mb",
+                                        cl::desc("Memory limit for rendered functions kept around by -serve, in MiB. "
+                                                 "Half of it is for their HTML, half for their IR"),
+                                        cl::value_desc("N"),
+                                        cl::init(256));
+
+/// Restricting which functions get rendered, all given criteria have to be met.
+static cl::opt<std::string> SelectName("select-name",
+                                       cl::desc("Only render functions whose name matches a regex"),
+                                       cl::value_desc("regex"));
+static cl::opt<std::string> SelectGlob("select-glob",
+                                       cl::desc("Only render functions whose name matches a glob pattern"),
+                                       cl::value_desc("pattern"));
+static cl::opt<std::string> SelectDemangled("select-demangled",
+                                            cl::desc("Only render functions whose demangled name matches a regex"),
+                                            cl::value_desc("regex"));
+static cl::opt<unsigned> SelectMinInstructions("select-min-instructions",
+                                               cl::desc("Only render functions with at least N instructions"),
+                                               cl::value_desc("N"),
+                                               cl::init(0));
+static cl::opt<unsigned> SelectMinLoopDepth("select-min-loop-depth",
+                                            cl::desc("Only render functions with loops nested at least N deep"),
+                                            cl::value_desc("N"),
+                                            cl::init(0));
+static cl::opt<std::string> SelectAround("select-around",
+                                         cl::desc("Only render functions close to this one in the call graph"),
+                                         cl::value_desc("function"));
+static cl::opt<unsigned> SelectHops("select-hops",
+                                    cl::desc("Maximum number of calls between a function and the one given by -select-around"),
+                                    cl::value_desc("N"),
+                                    cl::init(1));
 
 /// I've had enough *&^#$ memory corruption bugs with LLVMs legacy passmanager/analysis-cache.
 /// We'll just compute the stuff we need ourselves and basta.
 struct Analyses {
+  /// Per function analyses a renderer can ask for, see Renderer::requiredAnalyses().
+  /// Every kind includes the analyses it is computed from.
+  enum Kind : unsigned {
+    NONE     = 0,
+    DOM_TREE = 1 << 0,
+    LOOPS    = 1 << 1 | DOM_TREE,
+    SCEV     = 1 << 2 | LOOPS,
+  };
+
   Analyses(Module& m)
   : _module{m}
-  , _slots{&m, true}
+  , _slots{&m, false} // metadata of a function gets numbered when it is incorporated, also works for lazily loaded bodies
   , _inst_namer{_slots}
   , _tlii{Triple{m.getTargetTriple()}}
   , _tli{_tlii}
   {}
 
-  void recalculate(Function& fn) {
-    _function.reset(&fn);
+  /// Declare which analyses may be used, accessing any other one is a bug.
+  void setRequired(unsigned required) {
+    _required = required;
+  }
 
-    _domTree.recalculate(fn);
-    _loops.analyze(_domTree);
+  /// Switch to a new function.
+  /// Only the operand names of the function are printed right away (see ValueNameMangler::nameFunction()),
+  /// analyses are built on first access, so functions nobody asks about cost nothing.
+  void recalculate(Function& fn) {
+    release();
 
-    _assumptions.reset(new AssumptionCache{fn});
+    _function.reset(&fn);
+    _inst_namer.nameFunction(fn);
+  }
 
-    _scev.reset(new ScalarEvolution{
-      *_function,
-      _tli,
-      *_assumptions,
-      _domTree,
-      _loops
-    });
+  /// Drop all per function analyses.
+  /// Has to be called before the body of the function they were computed for is deleted.
+  void release() {
+    _scev.reset();
+    _assumptions.reset();
+    if (_has_loops)
+      _loops.releaseMemory(); // LoopInfo::analyze() does not forget loops of the previous function on its own
+    if (_has_dom_tree)
+      _domTree.reset();
+    _has_loops    = false;
+    _has_dom_tree = false;
+    _function.reset(nullptr);
   }
 
   Module& module() {
@@ -89,24 +232,92 @@ struct Analyses {
     return _inst_namer;
   }
 
+  ModuleSlotTracker& slots() {
+    return _slots;
+  }
+
+  DominatorTree& domTree() {
+    assert(isRequired(DOM_TREE) && "renderer did not declare that it needs the dominator tree");
+
+    if (!_has_dom_tree) {
+      TimeTrace::Scope span{"dominator tree"};
+      _domTree.recalculate(*_function);
+      _has_dom_tree = true;
+    }
+    return _domTree;
+  }
+
   LoopInfo& loops() {
+    assert(isRequired(LOOPS) && "renderer did not declare that it needs loop info");
+
+    if (!_has_loops) {
+      /// without a back edge there are no loops, and an empty LoopInfo says so without building the dominator tree
+      if (hasBackEdge(*_function)) {
+        DominatorTree& dom_tree = domTree();
+
+        TimeTrace::Scope span{"loop info"};
+        _loops.analyze(dom_tree);
+      }
+      _has_loops = true;
+    }
     return _loops;
   }
+
   ScalarEvolution& scev() {
+    assert(isRequired(SCEV) && "renderer did not declare that it needs scalar evolution");
+
+    if (!_scev) {
+      LoopInfo& loop_info = loops();
+
+      TimeTrace::Scope span{"scalar evolution"};
+      _assumptions.reset(new AssumptionCache{*_function});
+
+      _scev.reset(new ScalarEvolution{
+        *_function,
+        _tli,
+        *_assumptions,
+        domTree(),
+        loop_info
+      });
+    }
     return *_scev;
   }
 
+  bool isRequired(Kind kind) const {
+    return (_required & kind) == kind;
+  }
+
+  /// Does some block of @p fn branch to itself or to a block before it in the function.
+  /// If not, the order of the blocks is a topological order of the CFG, so it has no cycles and thus no loops.
+  /// Most functions without loops look like this, and checking it is much cheaper than building LoopInfo.
+  static bool hasBackEdge(const Function& fn) {
+    SmallPtrSet<const BasicBlock*, 32> seen;
+
+    for (auto& bb : fn) {
+      seen.insert(&bb);
+
+      for (auto succ : successors(&bb)) {
+        if (seen.count(succ))
+          return true;
+      }
+    }
+    return false;
+  }
+
   /// ***** module global
   Module& _module;
   ModuleSlotTracker _slots;
   ValueNameMangler _inst_namer;
   TargetLibraryInfoImpl _tlii;
   TargetLibraryInfo _tli;
+  unsigned _required = NONE;
 
-  /// ***** per fn
+  /// ***** per fn, built lazily
   safe_ptr<Function> _function; // the function these analyses are valid for
   DominatorTree _domTree;
+  bool _has_dom_tree = false;
   LoopInfo _loops;
+  bool _has_loops = false;
   std::unique_ptr<AssumptionCache> _assumptions;
   std::unique_ptr<ScalarEvolution> _scev;
 };
@@ -116,9 +327,55 @@ struct Analyses {
 struct Renderer {
   virtual ~Renderer() {}
 
+  /// Short unique name of the renderer, used for describing the configuration of a run (see RenderCache).
+  virtual StringRef name() const = 0;
+
+  /// Name of the @p idx-th column createRenderers() creates, for telling where time goes (see TimeTrace).
+  /// Only renderers that create more than one column need to override this.
+  virtual StringRef columnName(size_t idx) const { return name(); }
+
+  /// Per function analyses this renderer uses, a combination of Analyses::Kind.
+  /// Only analyses some renderer asks for are ever computed.
+  virtual unsigned requiredAnalyses() const = 0;
+
   // *********************************************************************************
   // ***** RENDER FUNCTION CODE
 
+  /***
+   * HTML text of the cells of the instruction table, see AttributeRenderer::renderBlock().
+   *
+   * Cells are printed back to back into one buffer, endCell() marks where each one ends.
+   * The buffer is reused for every basic block, so rendering a block does not allocate once it is large enough.
+   */
+  struct CellBuffer {
+    CellBuffer() : _OS{_text} {}
+
+    CellBuffer(const CellBuffer&) = delete;
+    CellBuffer& operator=(const CellBuffer&) = delete;
+
+    /// Stream for printing the HTML of the current cell.
+    raw_ostream& out() { return _OS; }
+
+    /// Everything printed since the last call belongs to the current cell, start the next one.
+    void endCell() { _ends.push_back(_text.size()); }
+
+    size_t size() const { return _ends.size(); }
+
+    StringRef cell(size_t idx) const {
+      size_t start = idx ? _ends[idx - 1] : 0;
+      return StringRef{_text}.slice(start, _ends[idx]);
+    }
+
+    void clear() {
+      _text.clear();
+      _ends.clear();
+    }
+  private:
+    SmallString<4096>   _text;
+    raw_svector_ostream _OS;
+    std::vector<size_t> _ends;
+  };
+
   /// Renders HTML for one instruction attribute.
   /// One renderer may spawn multiple AttributeRenderers
   struct AttributeRenderer {
@@ -131,6 +388,20 @@ struct Renderer {
     /// The returned HTML will be wrapped into a <td> tag in the instruction table.
     virtual Html* render(const Instruction& inst) = 0;
 
+    /// Renders the cells of all instructions of @p bb at once, in order, one cell per instruction.
+    /// The default prints what render() returns, renderers of large columns override this to print
+    /// their cells directly instead of building HTML nodes for every one of them (see createTextRenderer()).
+    virtual void renderBlock(const BasicBlock& bb, CellBuffer& cells) {
+      for (auto& inst : bb) {
+        render(inst)->print(cells.out());
+        cells.endCell();
+      }
+    }
+
+    /// Called once all instructions of a function have been rendered.
+    /// Returns HTML that is added below the code of the function, or nullptr if there is nothing to add.
+    virtual Html* renderFooter() { return nullptr; }
+
     /// Helper for the common case of just rendering a simple string.
     Html* renderStr(const std::string& str) {
       return html::str(str);
@@ -139,6 +410,8 @@ struct Renderer {
 
   /// Adjusts the style of the tbody for a BasicBlock
   struct BasicBlockStyler {
+    virtual ~BasicBlockStyler() {}
+
     /// Called once all instructions have been rendered to allow the styler to adjust CSS classes, etc.
     /// This is not supposed to add new elements, though the API currently does not prevent it.
     virtual void style(const BasicBlock& bb, SimpleTag* tbody) = 0;
@@ -151,6 +424,10 @@ struct Renderer {
   /// This function is called once per each llvm::Function
   virtual void createBasicBlockStylers(Analyses&, VectorAppender<std::unique_ptr<BasicBlockStyler>> dst) = 0;
 
+  /// Describes everything besides @p fn itself that affects the HTML rendered for it, like files that are read.
+  /// Used for telling whether HTML rendered before is still up to date, see RenderCache.
+  virtual void describeInputs(const Function& fn, raw_ostream& OS) = 0;
+
 protected:
   /// Helper for creating a simple renderer from lambdas
   void createRenderer(
@@ -159,11 +436,50 @@ protected:
     std::function<Html*(const Instruction&)> renderAttr
   );
 
+  /// Helper for creating a renderer that prints the HTML text of every cell directly.
+  /// @param printCell  called as `printCell(inst, OS)', the text it prints is not escaped
+  template<typename PrintCell>
+  void createTextRenderer(
+    VectorAppender<std::unique_ptr<AttributeRenderer>> dst,
+    StringRef header,
+    PrintCell printCell
+  ) {
+    dst.emplace_back(new TextRenderer<PrintCell>{header, std::move(printCell)});
+  }
+
   /// Helper for creating a simple styler from lambdas
   void createStyler(
     VectorAppender<std::unique_ptr<BasicBlockStyler>> dst,
     std::function<void(const BasicBlock&, SimpleTag*)> styler
   );
+private:
+  /// Calls a lambda to print every cell, see createTextRenderer().
+  /// A whole block is printed with one virtual call, and the lambda is not hidden behind a std::function.
+  template<typename PrintCell>
+  struct TextRenderer final : AttributeRenderer {
+    TextRenderer(StringRef header, PrintCell&& printCell) : _header{header}, _printCell{std::move(printCell)} {}
+
+    Html* renderColumnHeader() override { return html::str(_header); }
+
+    Html* render(const Instruction& inst) override {
+      std::string txt;
+      {
+        raw_string_ostream OS{txt};
+        _printCell(inst, OS);
+      }
+      return new RawHtml{txt};
+    }
+
+    void renderBlock(const BasicBlock& bb, CellBuffer& cells) override {
+      for (auto& inst : bb) {
+        _printCell(inst, cells.out());
+        cells.endCell();
+      }
+    }
+  private:
+    StringRef _header;
+    PrintCell _printCell;
+  };
 public:
 
   // *********************************************************************************
@@ -214,9 +530,13 @@ public:
 
 /// Helper class for implementing renderers. This implementation just renders nothing
 struct DummyRenderer : Renderer {
+  unsigned requiredAnalyses() const override { return Analyses::NONE; }
+
   void createRenderers(Analyses&, VectorAppender<std::unique_ptr<AttributeRenderer>> dst) override {}
   void createBasicBlockStylers(Analyses&, VectorAppender<std::unique_ptr<BasicBlockStyler>> dst) override {}
 
+  void describeInputs(const Function& fn, raw_ostream& OS) override {}
+
   void addControlCheckboxes(VectorAppender<ControlCheckbox> dst) override {}
   void addControlButtons(VectorAppender<ControlButton> dst) override {}
 
@@ -228,107 +548,382 @@ struct DummyRenderer : Renderer {
 //**********************************************************************************************************************
 // RENDERER IMPLEMENTATIONS
 
+/***
+ * Columns whose cells are simple text computed from the instruction alone.
+ *
+ * These are not Renderers of their own, they are listed in BuiltinColumns (see StaticColumnRenderer) instead,
+ * so printing their cells is dispatched at compile time and can be inlined into the loop over a basic block.
+ * Every column provides:
+ *   - NAME():   short unique name, for selecting columns (see -columns)
+ *   - HEADER(): text of the column header
+ *   - print():  prints the HTML text of the cell of one instruction
+ */
+
 /// Render instruction name (if present)
-struct NameRenderer : DummyRenderer {
-  void createRenderers(Analyses& analyses, VectorAppender<std::unique_ptr<AttributeRenderer>> dst) override {
-    createRenderer(
-      dst,
-      [&]() {
-        return html::str("Name");
-      },
-      [&](const Instruction& inst) {
-        if (!inst.getType()->isVoidTy()) {
-          return html::str(analyses.names().asOperand(inst));
-        } else {
-          return html::str("");
-        }
-      }
-    );
+struct NameColumn {
+  static constexpr const char* NAME()   { return "name"; }
+  static constexpr const char* HEADER() { return "Name"; }
+
+  static void print(Analyses& analyses, const Instruction& inst, raw_ostream& OS) {
+    if (!inst.getType()->isVoidTy())
+      print_str(OS, analyses.names().asOperand(inst));
   }
 };
 
 /// Render instruction type
-struct TypeRenderer : DummyRenderer {
-  void createRenderers(Analyses& analyses, VectorAppender<std::unique_ptr<AttributeRenderer>> dst) override {
-    createRenderer(
-      dst,
-      [&]() {
-        return html::str("Type");
-      },
-      [&](const Instruction& inst) {
-        auto ty = inst.getType();
+struct TypeColumn {
+  static constexpr const char* NAME()   { return "type"; }
+  static constexpr const char* HEADER() { return "Type"; }
 
-        std::string buf;
-        raw_string_ostream OS{buf};
+  static void print(Analyses& analyses, const Instruction& inst, raw_ostream& OS) {
+    print_str(OS, analyses.names().types().name(inst.getType()));
+  }
+};
 
-        ty->print(OS, false);
-        OS.flush();
+/// Render instruction opcode
+struct OpcodeColumn {
+  static constexpr const char* NAME()   { return "opcode"; }
+  static constexpr const char* HEADER() { return "Opcode"; }
 
-        return html::str(buf);
-      }
-    );
+  static void print(Analyses&, const Instruction& inst, raw_ostream& OS) {
+    OS << inst.getOpcodeName();
   }
 };
 
-/// Render instruction opcode
-struct OpcodeRenderer : DummyRenderer {
-  void createRenderers(Analyses& analyses, VectorAppender<std::unique_ptr<AttributeRenderer>> dst) override {
-    createRenderer(
-        dst,
-        [&]() {
-          return html::str("Opcode");
-        },
-        [&](const Instruction& inst) {
-          return html::str(inst.getOpcodeName());
-        }
-    );
+struct OperandsColumn {
+  static constexpr const char* NAME()   { return "operands"; }
+  static constexpr const char* HEADER() { return "Operands"; }
+
+  static void print(Analyses& analyses, const Instruction& inst, raw_ostream& OS) {
+    for (auto op : const_cast<Instruction&>(inst).operand_values()) {
+      analyses.names().printRef(op, OS);
+      OS << "<br>";
+    }
   }
 };
 
-struct OperandsRenderer : DummyRenderer {
+/// Renders a list of columns fixed at compile time, see NameColumn & co.
+/// Which of them show up is still decided at runtime.
+template<typename... Columns>
+struct StaticColumnRenderer final : DummyRenderer {
+  static constexpr const size_t NUM_COLUMNS() { return sizeof...(Columns); }
+
+  /// Names of all columns, in the order they appear.
+  static constexpr std::array<const char*, sizeof...(Columns)> names() {
+    return {{Columns::NAME()...}};
+  }
+
+  /// @param selected  names of the columns that are rendered, empty means all of them
+  explicit StaticColumnRenderer(const std::vector<std::string>& selected) {
+    raw_string_ostream OS{_name};
+
+    Separator sep{"+"};
+    for (size_t idx = 0; idx < NUM_COLUMNS(); idx++) {
+      _enabled[idx] = selected.empty() || is_contained(selected, names()[idx]);
+
+      if (_enabled[idx])
+        OS << sep.str() << names()[idx];
+    }
+  }
+
+  /// True if none of the columns is rendered.
+  bool empty() const {
+    return none_of(_enabled, [](bool enabled) { return enabled; });
+  }
+
+  StringRef name() const override { return _name; }
+
+  StringRef columnName(size_t idx) const override {
+    for (size_t col = 0; col < NUM_COLUMNS(); col++) {
+      if (_enabled[col] && !idx--)
+        return names()[col];
+    }
+    llvm_unreachable("renderer does not have that many columns");
+  }
+
   void createRenderers(Analyses& analyses, VectorAppender<std::unique_ptr<AttributeRenderer>> dst) override {
-    createRenderer(
-      dst,
-      [&]() {
-        return html::str("Operands");
-      },
-      [&](const Instruction& inst) {
-        auto wrapper = div();
-
-        for (auto op : const_cast<Instruction&>(inst).operand_values()) {
-          wrapper->add(
-            analyses.names().ref(op),
-            br()
-          );
+    size_t idx = 0;
+
+    /// expands to one call per column, in order
+    LLVM_ATTRIBUTE_UNUSED int expand[] = {0, (createColumn<Columns>(analyses, dst, idx++), 0)...};
+  }
+private:
+  template<typename Column>
+  void createColumn(Analyses& analyses, VectorAppender<std::unique_ptr<AttributeRenderer>> dst, size_t idx) {
+    if (!_enabled[idx])
+      return;
+
+    createTextRenderer(dst, Column::HEADER(), [&analyses](const Instruction& inst, raw_ostream& OS) {
+      Column::print(analyses, inst, OS);
+    });
+  }
+
+  std::array<bool, sizeof...(Columns)> _enabled;
+  std::string                          _name; // names of the enabled columns
+};
+
+using BuiltinColumns = StaticColumnRenderer<NameColumn, TypeColumn, OpcodeColumn, OperandsColumn>;
+
+/// render where instructions come from in the source code, according to their debug locations
+struct DebugLocRenderer final : DummyRenderer {
+  /// @param sources  if set, the source lines instructions come from are shown next to every function
+  explicit DebugLocRenderer(SourceIndex* sources = nullptr) : _sources{sources} {}
+
+  StringRef name() const override { return "location"; }
+
+  /// number of lines shown before & after every line some instruction comes from
+  static constexpr const unsigned SOURCE_CONTEXT() { return 2; }
+  /// maximum number of source lines shown per function, lines instructions come from are shown anyway
+  static constexpr const unsigned MAX_SOURCE_LINES() { return 1000; }
+
+  /// Path of the file @p loc points into
+  static std::string path(const DILocation* loc) {
+    StringRef file = loc->getFilename();
+    StringRef dir  = loc->getDirectory();
+
+    if (dir.empty() || sys::path::is_absolute(file))
+      return file.str();
+
+    SmallString<128> path{dir};
+    sys::path::append(path, file);
+    return path.str().str();
+  }
+
+  /***
+   * Renders the locations of the instructions of one function.
+   *
+   * Every location is rendered as `file:line:column', followed by the locations it was inlined at.
+   * If there is a SourceIndex, the lines of code locations point to are shown in a pane next to the function
+   * (see renderFooter()) and locations link there.
+   */
+  struct Locations final : AttributeRenderer {
+    Locations(ValueNameMangler& names, const Function& fn, SourceIndex* sources)
+    : _sources{sources}
+    , _id_prefix{names.getId(fn) + "-src-"}
+    {}
+
+    Html* renderColumnHeader() override {
+      return html::str("Location");
+    }
+
+    Html* render(const Instruction& inst) override {
+      auto loc = inst.getDebugLoc().get();
+
+      auto elem = div();
+
+      if (!loc)
+        return elem;
+
+      elem->add(renderLoc(loc));
+
+      for (auto at = loc->getInlinedAt(); at; at = at->getInlinedAt())
+        elem->add(br(), html::str("inlined at "), renderLoc(at));
+
+      return elem->withStyle(SimpleTag::FlowStyle);
+    }
+
+    Html* renderFooter() override {
+      if (_files.empty())
+        return nullptr;
+
+      auto pane = div(css_class("source-pane"));
+
+      unsigned budget   = MAX_SOURCE_LINES();
+      bool     left_out = false;
+
+      for (size_t idx = 0; idx < _files.size(); idx++) {
+        auto& file = _files[idx];
+
+        auto table = html::table(css_class("table source-table"));
+        table->add(tr(th(attr("colspan", 2u), file.path)));
+
+        unsigned last_shown = 0; // lines are shown in order, each at most once
+
+        for (unsigned hit : file.lines) {
+          unsigned first = std::max(last_shown + 1, (hit > SOURCE_CONTEXT()) ? hit - SOURCE_CONTEXT() : 1u);
+          unsigned last  = hit + SOURCE_CONTEXT();
+
+          for (unsigned line = first; line <= last; line++) {
+            bool is_hit = file.lines.count(line);
+
+            /// locations link to the lines they point to, so those are shown even once the budget is used up
+            if (!budget && !is_hit) {
+              left_out = true;
+              continue;
+            }
+
+            auto text = _sources->line(file.path, line);
+            if (!text)
+              break;
+
+            if (last_shown && (line > last_shown + 1))
+              table->add(tr(th(), td(html::str("..."))));
+
+            auto row = tr(
+              th(css_id(anchor(idx, line)), html::str(Twine(line))),
+              td(css_class("source-line"), html::str(printable(*text)))->withStyle(SimpleTag::FlowStyle)
+            );
+            if (is_hit)
+              row->addClass("source-hit");
+
+            table->add(row);
+
+            last_shown = line;
+            if (budget)
+              budget--;
+          }
         }
 
-        return wrapper;
+        pane->add(table);
       }
-    );
+
+      if (left_out)
+        pane->add(html::str("More source lines were left out"));
+
+      return pane;
+    }
+  private:
+    struct File {
+      std::string        path;
+      std::set<unsigned> lines; // lines instructions come from
+    };
+
+    Html* renderLoc(const DILocation* loc) {
+      std::string file = path(loc);
+      std::string txt  = (loc->getFilename() + ":" + Twine(loc->getLine()) + ":" + Twine(loc->getColumn())).str();
+
+      /// attribute values are not escaped for us
+      std::string title;
+      {
+        raw_string_ostream OS{title};
+        print_str(OS, file);
+      }
+
+      if (_sources && loc->getLine() && _sources->line(file, loc->getLine())) {
+        auto it = _file_idx.insert({file, unsigned(_files.size())}).first;
+        if (it->second == _files.size())
+          _files.push_back(File{file, {}});
+
+        _files[it->second].lines.insert(loc->getLine());
+
+        auto link = html::a(attr("href", '#' + anchor(it->second, loc->getLine())), attr("title", title), txt);
+        return link->withStyle(SimpleTag::FlowStyle);
+      }
+
+      return html::span(attr("title", title), txt);
+    }
+
+    std::string anchor(size_t file, unsigned line) {
+      return (_id_prefix + Twine(file) + "-" + Twine(line)).str();
+    }
+
+    /// Source files may contain control chars that can not be printed as HTML
+    static std::string printable(StringRef line) {
+      std::string txt = line.str();
+
+      for (char& c : txt) {
+        if ((static_cast<unsigned char>(c) < 0x20) && (c != '\t'))
+          c = '?';
+      }
+      return txt;
+    }
+
+    SourceIndex*         _sources;
+    std::string          _id_prefix;
+    std::vector<File>    _files;
+    StringMap<unsigned>  _file_idx; // position of files in _files
+  };
+
+  void createRenderers(Analyses& analyses, VectorAppender<std::unique_ptr<AttributeRenderer>> dst) override {
+    dst.emplace_back(new Locations{analyses.names(), analyses.function(), _sources});
+  }
+
+  void describeInputs(const Function& fn, raw_ostream& OS) override {
+    if (!_sources)
+      return;
+
+    /// contents of all source files shown
+    std::set<std::string> files;
+
+    for (auto& bb : fn) {
+      for (auto& inst : bb) {
+        for (auto loc = inst.getDebugLoc().get(); loc; loc = loc->getInlinedAt())
+          files.insert(path(loc));
+      }
+    }
+
+    for (auto& file : files)
+      OS << file << ' ' << _sources->digest(file) << '\n';
+  }
+
+  void addControlCheckboxes(VectorAppender<ControlCheckbox> dst) override {
+    if (_sources)
+      dst.emplace_back("Display source", "display-source", true);
   }
+
+  Optional<std::string> addCss() override {
+    if (!_sources)
+      return None;
+
+    /// the source pane sits next to the code and stays in view while scrolling
+    return std::string{R"(
+      .function-code { display: grid; grid-template-columns: minmax(0, 1fr) auto; }
+      .function-code > * { grid-column: 1; }
+      .function-code > .source-pane {
+        grid-column: 2; grid-row: 1 / span 3; align-self: start;
+        position: sticky; top: 0; max-height: 100vh; overflow: auto;
+      }
+      body:not(.display-source) .function .source-pane { display: none; }
+      .source-table td.source-line { white-space: pre; font-family: monospace; }
+      .source-table tr.source-hit  { background-color: #fcf8e3; }
+      .source-table tr:target      { background-color: #f0ad4e; }
+    )"};
+  }
+private:
+  SourceIndex* _sources;
 };
 
 struct ScevRenderer : DummyRenderer {
-  struct Visitor : SCEVVisitor<Visitor, void> {
-    Visitor(ValueNameMangler& namer) : _namer{namer}, _html{div()} {}
+  StringRef name() const override { return "scev"; }
+  unsigned requiredAnalyses() const override { return Analyses::SCEV; }
+
+  /// Subexpressions whose HTML is at least this long are only printed in full where they first occur in a function,
+  /// other occurrences link there.
+  static constexpr const size_t MIN_SHARED_SIZE = 512;
+
+  /***
+   * Prints SCEV expressions of one function straight to HTML text.
+   *
+   * SCEV expressions are uniqued DAGs, add recurrences of nested loops share most of their operands.
+   * So every subexpression is only rendered once per function:
+   * the HTML of small ones is cached and copied, large ones get an anchor and are linked to when they occur again.
+   */
+  struct Printer : SCEVVisitor<Printer, void> {
+    /// @param id_prefix  prefix for the IDs of shared subexpressions, has to be unique in the page
+    Printer(ValueNameMangler& namer, std::string id_prefix) : _namer{namer}, _id_prefix{std::move(id_prefix)}, _OS{_buf} {}
+
+    /// Returns the HTML for @p expr, wrapped in a <div>.
+    Html* render(const SCEV* expr) {
+      _buf.clear();
+
+      _OS << "<div>";
+      print(expr);
+      _OS << "</div>";
+
+      return new RawHtml{_buf};
+    }
 
     void visitConstant(const SCEVConstant* expr) {
-      emit(_namer.ref(expr->getValue()));
+      _namer.printRef(expr->getValue(), _OS);
     }
     void visitTruncateExpr(const SCEVTruncateExpr* expr) {
-      emit("(trunc " + print(*expr->getOperand()->getType()) + " ");
-      visit(expr->getOperand());
-      emit(" to " + print(*expr->getOperand()->getType()) + ")");
+      visitCast("trunc", expr);
     }
     void visitSignExtendExpr(const SCEVSignExtendExpr* expr) {
-      emit("(sext " + print(*expr->getOperand()->getType()) + " ");
-      visit(expr->getOperand());
-      emit(" to " + print(*expr->getOperand()->getType()) + ")");
+      visitCast("sext", expr);
     }
     void visitZeroExtendExpr(const SCEVZeroExtendExpr* expr) {
-      emit("(zext " + print(*expr->getOperand()->getType()) + " ");
-      visit(expr->getOperand());
-      emit(" to " + print(*expr->getOperand()->getType()) + ")");
+      visitCast("zext", expr);
     }
     void visitAddExpr(const SCEVAddExpr* expr) {
       visitNAry(expr, " + ");
@@ -338,18 +933,18 @@ struct ScevRenderer : DummyRenderer {
     }
     void visitUDivExpr(const SCEVUDivExpr* expr) {
       emit("(");
-      visit(expr->getLHS());
+      print(expr->getLHS());
       emit("/u");
-      visit(expr->getRHS());
+      print(expr->getRHS());
       emit(")");
     }
     void visitAddRecExpr(const SCEVAddRecExpr* AR) {
       emit("{");
-      visit(AR->getOperand(0));
+      print(AR->getOperand(0));
 
       for (unsigned i = 1, e = AR->getNumOperands(); i != e; ++i) {
         emit(" ,+, ");
-        visit(AR->getOperand(i));
+        print(AR->getOperand(i));
       }
 
       emit("}<");
@@ -361,7 +956,7 @@ struct ScevRenderer : DummyRenderer {
       if (AR->hasNoSelfWrap() && !AR->getNoWrapFlags((SCEV::NoWrapFlags) (SCEV::FlagNUW | SCEV::FlagNSW)))
         emit("nw><");
 
-      emit(_namer.ref(AR->getLoop()->getHeader()));
+      _namer.printRef(AR->getLoop()->getHeader(), _OS);
       emit(">");
     }
     void visitSMaxExpr(const SCEVSMaxExpr* expr) {
@@ -373,30 +968,50 @@ struct ScevRenderer : DummyRenderer {
     void visitUnknown(const SCEVUnknown* U) {
       Type *AllocTy;
       if (U->isSizeOf(AllocTy)) {
-        emit("sizeof(" + print(*AllocTy) + ")");
+        emit("sizeof(");
+        emit(*AllocTy);
+        emit(")");
         return;
       }
       if (U->isAlignOf(AllocTy)) {
-        emit("alignof(" + print(*AllocTy) + ")");
+        emit("alignof(");
+        emit(*AllocTy);
+        emit(")");
         return;
       }
 
       Type *CTy;
       Constant *FieldNo;
       if (U->isOffsetOf(CTy, FieldNo)) {
-        emit("offsetof(" + print(*CTy) + ", ", _namer.ref(FieldNo), ")");
+        emit("offsetof(");
+        emit(*CTy);
+        emit(", ");
+        _namer.printRef(FieldNo, _OS);
+        emit(")");
         return;
       }
 
       // Otherwise just print it normally.
-      emit(_namer.ref(U->getValue()));
+      _namer.printRef(U->getValue(), _OS);
+    }
+
+    void visitCast(StringRef op, const SCEVCastExpr* expr) {
+      emit("(");
+      emit(op);
+      emit(" ");
+      emit(*expr->getOperand()->getType());
+      emit(" ");
+      print(expr->getOperand());
+      emit(" to ");
+      emit(*expr->getType());
+      emit(")");
     }
 
     void visitNAry(const SCEVNAryExpr* NAry, StringRef op) {
       emit("(");
 
       for (SCEVNAryExpr::op_iterator I = NAry->op_begin(), E = NAry->op_end(); I != E; ++I) {
-        visit(*I);
+        print(*I);
 
         if (std::next(I) != E)
           emit(op);
@@ -409,116 +1024,272 @@ struct ScevRenderer : DummyRenderer {
           if (NAry->hasNoUnsignedWrap())
             emit("<nuw>");
           if (NAry->hasNoSignedWrap())
-            emit("<nuw>");
+            emit("<nsw>");
+      }
+    }
+  private:
+    /// What we know about a subexpression we already printed.
+    struct Printed {
+      std::string html;   // HTML of small expressions
+      unsigned    shared; // number of the anchor of large expressions, 0 for small ones
+    };
+
+    /// Prints @p expr, or a link to where it was printed before.
+    void print(const SCEV* expr) {
+      auto it = _printed.find(expr);
+
+      if (it != _printed.end()) {
+        if (it->second.shared)
+          printLink(it->second.shared);
+        else
+          _OS << it->second.html;
+        return;
+      }
+
+      size_t start = _buf.size();
+
+      visit(expr);
+
+      StringRef html = _buf.str().substr(start);
+
+      if (html.size() < MIN_SHARED_SIZE) {
+        _printed[expr] = Printed{html.str(), 0};
+        return;
       }
+
+      unsigned shared = ++_num_shared;
+      _printed[expr] = Printed{std::string{}, shared};
+
+      /// large expressions can only contain the anchors of other large ones, so copying small ones never duplicates IDs
+      std::string open;
+      raw_string_ostream{open} << "<span class=\"scev-shared\" id=\"" << _id_prefix << shared << "\">";
+      _buf.insert(_buf.begin() + start, open.begin(), open.end());
+      _OS << "</span>";
     }
 
-    SimpleTag* html() {
-      return _html;
+    void printLink(unsigned shared) {
+      _OS << "<a class=\"scev-ref\" href=\"#" << _id_prefix << shared << "\" title=\"shared subexpression\">";
+      _OS << "[" << shared << "]</a>";
     }
-  private:
-    template<typename... T>
-    void emit(T&&... t) {
-      _html->add(std::forward<T>(t)...);
+
+    void emit(StringRef txt) {
+      print_str(_OS, txt);
+    }
+    void emit(const Type& type) {
+      print_str(_OS, _namer.types().name(&type));
     }
 
     ValueNameMangler& _namer;
-    SimpleTag*        _html;
+    std::string       _id_prefix;
+    unsigned          _num_shared = 0;
+
+    DenseMap<const SCEV*, Printed> _printed;
+
+    SmallString<256>    _buf;
+    raw_svector_ostream _OS;
   };
 
   void createRenderers(Analyses& analyses, VectorAppender<std::unique_ptr<AttributeRenderer>> dst) override {
+    /// one printer per function, SCEV expressions do not outlive the function they were computed for
+    auto printer = std::make_shared<Printer>(analyses.names(), analyses.names().getId(analyses.function()) + "-scev-");
+
     createRenderer(
       dst,
       [&]() {
         return html::str("SCEV");
       },
-      [&](const Instruction& inst) mutable -> Html* {
-        auto& inst_namer = analyses.names();
-        auto& loops      = analyses.loops();
-        auto& scev       = analyses.scev();
+      [&analyses, printer](const Instruction& inst) mutable -> Html* {
+        /// only instructions in loops get an expression, check that first so SCEV is never built for loop-free code
+        if (!analyses.loops().getLoopFor(inst.getParent()))
+          return div();
+
+        auto& scev = analyses.scev();
 
-        if (!scev.isSCEVable(inst.getType()) || !loops.getLoopFor(inst.getParent()))
+        if (!scev.isSCEVable(inst.getType()))
           return div();
 
         auto expr = scev.getSCEV(const_cast<Instruction*>(&inst));
         assert(expr);
 
-        Visitor v{inst_namer};
-        v.visit(expr);
-
-        return v.html()->withStyle(SimpleTag::FlowStyle);
+        return printer->render(expr);
       }
     );
   }
+
+  Optional<std::string> addCss() override {
+    return std::string{R"(
+      .scev-shared:target { background-color: #fcf8e3; }
+    )"};
+  }
 };
 
 /// render instruction metadata
 struct MetadataRenderer final : DummyRenderer {
-  void createRenderers(Analyses& analyses, VectorAppender<std::unique_ptr<AttributeRenderer>> dst) override {
-    createRenderer(
-      dst,
-      [&]() {
-        return html::str("Metadata");
-      },
-      [&](const Instruction& inst) mutable -> Html* {
-        auto& inst_namer = analyses.names();
-        auto& loops      = analyses.loops();
-        auto& scev       = analyses.scev();
+  StringRef name() const override { return "metadata"; }
+
+  /// nodes more than this many references away from an instruction are left out
+  static constexpr const unsigned MAX_DEPTH() { return 6; }
+  /// maximum number of nodes rendered per function, debug info easily references thousands
+  static constexpr const unsigned MAX_NODES() { return 256; }
+  /// longer strings are cut off
+  static constexpr const size_t MAX_STRING_LENGTH() { return 256; }
+
+  /***
+   * Renders the metadata of the instructions of one function.
+   *
+   * Instructions only link to the nodes attached to them.
+   * Every distinct node is rendered once, in a table below the code of the function (see renderFooter()),
+   * up to MAX_DEPTH() references away from the instructions and up to MAX_NODES() nodes in total.
+   */
+  struct Attachments final : AttributeRenderer {
+    Attachments(ValueNameMangler& names, const Function& fn)
+    : _names{names}
+    , _id_prefix{names.getId(fn) + "-md-"}
+    {
+      fn.getContext().getMDKindNames(_kinds);
+    }
 
-        auto& ctx = inst.getContext();
+    Html* renderColumnHeader() override {
+      return html::str("Metadata");
+    }
 
-        SmallVector<std::pair<unsigned, MDNode*>, 4> mds;
-        inst.getAllMetadata(mds);
+    Html* render(const Instruction& inst) override {
+      /// debug locations have a column of their own, see DebugLocRenderer
+      SmallVector<std::pair<unsigned, MDNode*>, 4> mds;
+      inst.getAllMetadataOtherThanDebugLoc(mds);
 
-        SmallVector<StringRef, 8> md_kinds;
-        ctx.getMDKindNames(md_kinds);
+      auto elem = div();
 
-        std::function<Html*(Metadata*)> render = [&](Metadata* md) -> Html* {
-          if (!md) {
-            return html::str("null");
-          }
-          if (auto val = dyn_cast<ValueAsMetadata>(md)) {
-            return inst_namer.ref(val->getValue());
-          }
-          if (auto node = dyn_cast<MDNode>(md)) {
-            auto elem = span();
+      bool first = true;
+      for (auto md : mds) {
+        if (!first)
+          elem->add(br());
+        first = false;
 
-            elem->add("{");
+        elem->add(html::str(_kinds[md.first] + " -> "), renderRef(md.second, 1));
+      }
 
-            for (const auto& sub : node->operands()) {
-//              elem->add(print(*sub));
-              elem->add(render(sub));
-            }
+      return elem;
+    }
 
-            elem->add("}");
+    Html* renderFooter() override {
+      if (_nodes.empty())
+        return nullptr;
 
-            return elem->withStyle(SimpleTag::FlowStyle);
-          }
+      auto table = html::table(css_class("table metadata-table"));
 
-          auto str = cast<MDString>(md);
-          return html::str(str->getString());
-        };
+      /// rendering a node can queue more nodes, so no range based loop
+      for (size_t i = 0; i < _nodes.size(); i++) {
+        auto node = _nodes[i];
 
-        bool first = true;
-
-        auto elem = div();
+        table->add(
+          tr(
+            th(css_id(_id_prefix + Twine(i)), html::str("md." + Twine(i))),
+            td(renderNode(node.first, node.second))
+          )
+        );
+      }
 
-        for (auto md : mds) {
-          if (!first)
-            elem->add(br());
-          first = false;
+      if (_truncated)
+        table->add(tr(th(), td(html::str("Some metadata was left out, it is too large or nested too deep"))));
 
-          elem->add(html::str(md_kinds[md.first] + " -> "), render(md.second));
+      return table;
+    }
+  private:
+    /// Link to the entry for @p node, which is @p depth references away from an instruction.
+    Html* renderRef(const MDNode* node, unsigned depth) {
+      auto it = _numbers.find(node);
+
+      if (it == _numbers.end()) {
+        if ((depth > MAX_DEPTH()) || (_nodes.size() >= MAX_NODES())) {
+          _truncated = true;
+          return html::str("...");
         }
 
-        return elem;
+        it = _numbers.insert({node, unsigned(_nodes.size())}).first;
+        _nodes.emplace_back(node, depth);
       }
-    );
+
+      auto link = html::a(attr("href", "#" + _id_prefix + Twine(it->second)), html::str("md." + Twine(it->second)));
+      return link->withStyle(SimpleTag::FlowStyle);
+    }
+
+    Html* renderNode(const MDNode* node, unsigned depth) {
+      auto elem = span();
+
+      if (node->isDistinct())
+        elem->add("distinct ");
+
+      elem->add("!{");
+
+      bool first = true;
+      for (const auto& op : node->operands()) {
+        if (!first)
+          elem->add(", ");
+        first = false;
+
+        elem->add(renderOperand(op, depth + 1));
+      }
+
+      elem->add("}");
+
+      return elem->withStyle(SimpleTag::FlowStyle);
+    }
+
+    Html* renderOperand(const Metadata* md, unsigned depth) {
+      if (!md)
+        return html::str("null");
+      if (auto val = dyn_cast<ValueAsMetadata>(md))
+        return _names.ref(val->getValue());
+      if (auto node = dyn_cast<MDNode>(md))
+        return renderRef(node, depth);
+
+      StringRef str = cast<MDString>(md)->getString();
+
+      std::string txt = "!\"";
+      for (char c : str.take_front(MAX_STRING_LENGTH())) {
+        if (isprint(static_cast<unsigned char>(c)) && (c != '"') && (c != '\\')) {
+          txt += c;
+        } else {
+          txt += '\\';
+          txt += hexdigit((c >> 4) & 0xF);
+          txt += hexdigit(c & 0xF);
+        }
+      }
+      txt += (str.size() > MAX_STRING_LENGTH()) ? "...\"" : "\"";
+
+      return html::str(txt);
+    }
+
+    ValueNameMangler&                 _names;
+    std::string                       _id_prefix;
+    SmallVector<StringRef, 32>        _kinds;
+
+    DenseMap<const MDNode*, unsigned>                 _numbers; // position of nodes in _nodes
+    std::vector<std::pair<const MDNode*, unsigned>>   _nodes;   // nodes to render, with their depth
+    bool                                              _truncated = false;
+  };
+
+  void createRenderers(Analyses& analyses, VectorAppender<std::unique_ptr<AttributeRenderer>> dst) override {
+    dst.emplace_back(new Attachments{analyses.names(), analyses.function()});
+  }
+
+  void addControlCheckboxes(VectorAppender<ControlCheckbox> dst) override {
+    dst.emplace_back("Display metadata", "display-metadata", true);
+  }
+
+  Optional<std::string> addCss() override {
+    return std::string{R"(
+      body:not(.display-metadata) .function table.metadata-table { display: none; }
+    )"};
   }
 };
 
 /// style basic blocks to show loop depth as colors
 struct LoopDepthStyler final : DummyRenderer {
+  StringRef name() const override { return "loop-depth"; }
+  unsigned requiredAnalyses() const override { return Analyses::LOOPS; }
+
   static constexpr const unsigned MAX_DEPTH() { return  7; }
 
   void createBasicBlockStylers(Analyses& analyses, VectorAppender<std::unique_ptr<BasicBlockStyler>> dst) override {
@@ -575,6 +1346,8 @@ struct LoopDepthStyler final : DummyRenderer {
 
 /// Adds checkboxes for hiding the code & arguments & loop-info of functions.
 struct HideCodeStyler final : DummyRenderer {
+  StringRef name() const override { return "hide-code"; }
+
   void addControlCheckboxes(VectorAppender<ControlCheckbox> dst) {
     dst.emplace_back("Display arguments", "display-args",  true);
     dst.emplace_back("Display code",      "display-code",  true);
@@ -594,395 +1367,167 @@ struct HideCodeStyler final : DummyRenderer {
 //**********************************************************************************************************************
 // Main Pass for actually printing HTML for a Module.
 
-struct HtmlPrinter {
-  HtmlPrinter(Module& m) : analyses{m} {}
-
-  bool run(raw_ostream& OS) {
-    /// Register renderers for instruction attributes we visualize
-
-    _renderers.emplace_back(new NameRenderer{});
-    _renderers.emplace_back(new TypeRenderer{});
-    _renderers.emplace_back(new OpcodeRenderer{});
-    _renderers.emplace_back(new OperandsRenderer{});
-    _renderers.emplace_back(new ScevRenderer{});
-    _renderers.emplace_back(new MetadataRenderer{});
-
-    _renderers.emplace_back(new LoopDepthStyler{});
-    _renderers.emplace_back(new HideCodeStyler{});
-
-    /// Hard coded CSS
+/// Reports @p err and exits if it is an error.
+/// Only call this on the main thread, exiting destroys globals other threads may still be using.
+static void exitOnError(Error err) {
+  if (err) {
+    logAllUnhandledErrors(std::move(err), errs(), "llvm-viz: ");
+    exit(1);
+  }
+}
 
-    OS << "<!DOCTYPE html>\n";
+/// Renders the HTML for single functions of a module.
+/// Holds all per-function state, so parallel renderers each need their own instance.
+struct FunctionPrinter {
+  /// @param sharded   every function is printed to its own page, see ValueNameMangler::setShardedOutput()
+  /// @param selected  which functions get rendered, by position in the module. Empty means all of them.
+  /// @param cache     if set, functions that did not change since they were cached are not rendered again
+  FunctionPrinter(Module& m,
+                  const std::vector<std::unique_ptr<Renderer>>& renderers,
+                  bool sharded = false,
+                  const std::vector<bool>& selected = {},
+                  const RenderCache* cache = nullptr)
+  : analyses{m}
+  , _renderers{renderers}
+  , _cache{cache}
+  {
+    analyses.names().setShardedOutput(sharded);
+
+    unsigned required = Analyses::NONE;
+    for (auto& renderer : renderers)
+      required |= renderer->requiredAnalyses();
+    analyses.setRequired(required);
+
+    if (!selected.empty()) {
+      size_t idx = 0;
+      for (auto& fn : m) {
+        if (!selected[idx++])
+          names().markNotRendered(fn);
+      }
+    }
+  }
 
-    auto doc = tag("html", attr("lang", "en"));
+  ValueNameMangler& names() {
+    return analyses.names();
+  }
 
-    {
-      auto head = tag("head");
-
-      head->add(
-        meta(attr("charset", "utf-8")),
-        meta(attr("http-equiv", "X-UA-Compatible"), attr("content", "IE=edge")),
-        meta(attr("name", "viewport"), attr("content", "width=device-width, initial-scale=1")),
-        meta(attr("name", "description"), attr("content", "llvm-IR visualization")),
-        meta(attr("name", "author"), attr("content", "Fader A. Vader"))
-      );
+  ModuleSlotTracker& slots() {
+    return analyses.slots();
+  }
 
-      head->add(style(R"(
-        /******************************************/
-        /* general table styles */
+  /// Keep bodies of lazily loaded functions once they were materialized, so they can be rendered again.
+  void setKeepBodies(bool keep) {
+    _keep_bodies = keep;
+  }
 
-        th { text-align: center; }
+  /// Runs @p callback with the body of @p fn loaded.
+  /// Bodies of lazily loaded functions are only materialized for the duration of the callback
+  /// and deleted again right after, so only one function body is in memory at a time.
+  /// Fails without calling @p callback if the body can not be loaded. This may run on a worker thread,
+  /// so reporting the error is left to the caller, see exitOnError().
+  Error withBody(Function& fn, function_ref<void()> callback) {
+    bool lazy = fn.isMaterializable();
 
+    if (lazy) {
+      TimeTrace::Scope span{"materialize"};
 
-        /******************************************/
-        /* collapsable code for function */
+      if (auto err = fn.materialize())
+        return make_error<StringError>("Could not load function `" + fn.getName() + "': " + toString(std::move(err)),
+                                       inconvertibleErrorCode());
+    }
 
-        /*
-         * the collapse/expand `button' is implemented as a link,
-         * disable underlining and selection to make it feel more like a button
-         */
-        .function-collapse-btn, .function-expand-btn {
-           margin-left: 0.5em;
-           text-decoration: none !important;
-           -moz-user-select: none;
-        }
+    callback();
 
-        .function           .expander  { display: none; }
-        .function.collapsed .expander  { display: inline; }
-        .function.collapsed .collapser { display: none; }
-
-        #collapse-all-btn           .expander  { display: none; }
-        #collapse-all-btn.collapsed .expander  { display: inline; }
-        #collapse-all-btn.collapsed .collapser { display: none; }
-
-
-        /******************************************/
-        /* collapsable overlay for showing CFG */
-
-        /* The Overlay (background) */
-        #cfg-overlay {
-            /* Height & width depends on how you want to reveal the overlay (see JS below) */
-            height: 0;
-            width: 100%;
-            position: fixed; /* Stay in place */
-            z-index: 200;    /* Sit on top */
-            left: 0;
-            top: 0;
-            background-color: rgb(0,0,0); /* Black fallback color */
-            background-color: rgba(0,0,0, 0.9); /* Black w/opacity */
-            overflow-x: hidden; /* Disable horizontal scroll */
-            transition: 0.5s; /* 0.5 second transition effect to slide in or slide down the overlay (height or width, depending on reveal) */
-        }
+    if (lazy && !_keep_bodies) {
+      analyses.release();
+      fn.deleteBody();
+      names().markBodyDropped(fn);
+    }
+    return Error::success();
+  }
 
-        /* Position the content inside the overlay */
-        #cfg-overlay-content {
-            position: relative;
-            top: 25%; /* 25% from the top */
-            width: 100%; /* 100% width */
-            text-align: center; /* Centered text/links */
-            margin-top: 30px; /* 30px top margin to avoid conflict with the close button on smaller screens */
-        }
+  /// Describes everything besides @p fn itself the renderers read when rendering it, see Renderer::describeInputs().
+  std::string describeInputs(const Function& fn) {
+    std::string inputs;
+    raw_string_ostream OS{inputs};
 
-        /* The navigation links inside the overlay */
-        #cfg-overlay a {
-            padding: 8px;
-            text-decoration: none;
-            font-size: 36px;
-            color: #818181;
-            display: block; /* Display block instead of inline */
-            transition: 0.3s; /* Transition effects on hover (color) */
-        }
+    for (auto& renderer : _renderers)
+      renderer->describeInputs(fn, OS);
 
-        /* When you mouse over the navigation links, change their color */
-        #cfg-overlay a:hover, #cfg-overlay a:focus {
-            color: #f1f1f1;
-        }
+    return OS.str();
+  }
 
-        /* Position the close button (top right corner) */
-        #cfg-overlay-closebtn {
-            position: absolute;
-            top:      2ex;
-            right:    2em;
-        }
+  /// Renders the HTML for a function and prints it right away.
+  /// The DOM for the function lives in its own arena which is dropped once it is printed,
+  /// so peak memory is bounded by the largest function and not the whole module.
+  /// Fails if the body of @p fn can not be loaded, see withBody().
+  Error emitFunction(Function& fn, raw_ostream& OS, unsigned indent) {
+    TimeTrace::Scope span{"function", fn.getName()};
 
-        /*
-         * When the height of the screen is less than 450 pixels, change the
-         * font-size of the links and position the close button again,
-         * so they don't overlap
-         */
-        @media screen and (max-height: 450px) {
-            #cfg-overlay a {font-size: 20px}
-            #cfg-overlay-closebtn {
-                font-size: 40px !important;
-                top: 15px;
-                right: 35px;
-            }
-        }
+    return withBody(fn, [&]() {
+      if (!_cache) {
+        printFunction(fn, OS, indent);
+        return;
+      }
 
-        .cfg-image {
-            display: none;
-        }
+      auto key = _cache->key(fn, indent, slots(), names(), describeInputs(fn));
 
-        /******************************************/
-        /* fixed position bar on top of page with checkboxes for enabling/disabling display flags */
-
-        #control-bar {
-            position: fixed;
-            top: 0;
-            right: 0;
-            z-index: 100;
-            background-color: rgb(220,220,220);
-            border-radius: 0 0 0 1em;
-            padding: 2em;
-            width: auto;
-        }
+      if (!_cache->lookup(key, OS)) {
+        std::string buf;
+        raw_string_ostream FOS{buf};
 
-        #control-bar th {
-          text-align: center;
-        }
-      )"));
-      head->add(style(BootstrapCssSource()));
+        printFunction(fn, FOS, indent);
+        FOS.flush();
 
-      for (auto& renderer: _renderers) {
-        if (auto code = renderer->addCss()) {
-          head->add(style(*code));
-        }
+        _cache->store(key, buf);
+        OS << buf;
       }
+    });
+  }
 
-      head->add(tag("title", analyses.module().getModuleIdentifier()));
-
-      doc->add(head);
-    }
-
-    auto body = tag("body");
-
-    /// Render control bar which contains buttons & checkboxes for various flags & display actions
+private:
+  void printFunction(Function& fn, raw_ostream& OS, unsigned indent) {
+    _compact = (indent == Html::FLOW_STYLE);
     {
-      std::vector<Renderer::ControlCheckbox> checkboxes;
-      std::vector<Renderer::ControlButton>   buttons;
-
-      auto control_bar = table(css_id("control-bar"), css_class("table"));
+      HtmlArena::Scope fn_scope{_fn_arena};
 
-      /// Render fold all functions button
+      Html* html;
       {
-        auto fold_all = a(
-          css_id("collapse-all-btn"),
-          css_class("btn-link"),
-          attr("href", "javascript:void(0)"),
-          span(css_class("collapser"), "Collapse all functions"),
-          span(css_class("expander"), "Expand all functions")
-        );
-
-        control_bar->add(
-          tr(
-            th(
-              attr("colspan", 2),
-              css_class("control-bar-control"),
-              fold_all
-            )
-          )
-        );
+        TimeTrace::Scope span{"render"};
+        html = renderFunction(fn);
       }
-
-      control_bar->add(tr());
-
-      /// Render checkboxes for various display flags
       {
-        for (auto& renderer : _renderers) {
-          renderer->addControlCheckboxes(checkboxes);
-          renderer->addControlButtons(buttons);
-        }
-
-        for (auto& button : buttons) {
-          control_bar->add(
-            tr(
-              th(
-                attr("colspan", 2),
-                html::a(
-                  css_id(button.css_id),
-                  button.display_name
-                )
-              )
-            )
-          );
-        }
-
-        control_bar->add(tr());
-
-        for (auto& flag : checkboxes) {
-          auto checkbox = html::input(
-            "checkbox",
-            css_id(flag.css_id),
-            attr("data-flag", flag.css_id)
-          );
-
-          if (flag.initially_checked) {
-            body->addClass(flag.css_id);
-            checkbox->addAttr("checked");
-          }
-
-          control_bar->add(
-            tr(
-              th(checkbox),
-              th(flag.display_name)
-            )
-          );
-        }
+        TimeTrace::Scope span{"print"};
+        html->print(OS, indent);
       }
-
-      body->add(control_bar);
     }
+    _fn_arena.reset();
+  }
 
-    /// add overlay for displaying function CFG
+  Html* renderFunction(Function& fn) {
     {
-      /**
-       * Important elements classes:
-       *  - #cfg-overlay .......... container for the whole overlay the CFG image is shown here
-       *  - .cfg-overlay-closer ... any link with this class closes the overlay when clicked.
-       */
-
-      auto overlay = div(
-        attr("id", "cfg-overlay"),
-
-        /// close button for the overlay
-        // <a href="javascript:void(0)" class="closebtn" onclick="closeNav()">&times;</a>
-        html::a(
-          css_id("cfg-overlay-closebtn"),
-          css_class("cfg-overlay-closer btn-large btn-link"),
-          attr("href", "javascript:void(0)"),
-          html::times(), "close"
-        ),
-
-        /// overlay content
-        html::div(
-          css_id("cfg-overlay-content"),
-          new VerbatimTag("div", R"XO(
-            <svg >
-              <defs>
-                <linearGradient id="grad1" x1="0%" y1="0%" x2="100%" y2="0%">
-                  <stop offset="0%"   style="stop-color:rgb(255,255,0);stop-opacity:1" />
-                  <stop offset="100%" style="stop-color:rgb(255,0,0);stop-opacity:1" />
-                </linearGradient>
-              </defs>
-              <ellipse cx="100" cy="70" rx="85" ry="55" fill="url(#grad1)" />
-                 <text fill="#ffffff" font-size="45" font-family="Verdana" x="50" y="86">
-                   <a xlink:href="#_at_main2" class="cfg-overlay-closer">main2</a>
-                 </text>
-                 Sorry, your browser does not support inline SVG.
-            </svg>
-          )XO")
-        )
-      );
-
-      body->add(overlay);
-    }
-
-    for (auto& fn : analyses.module()) {
-      if (fn.empty())
-        continue;
-
-      auto fn_html = emitFunction(fn);
-
-      body->add(fn_html);
-    }
-
-    body->add(script(jQuerySource()));
-    body->add(script(BootstrapJsSource()));
-
-    /// JS for enabling/disabling the display flags from checkboxes in the control-bar
-    body->add(script(R"(
-        $('#control-bar input:checkbox').change(function(){
-          var css_class = $(this).data('flag');
-
-          if ($(this).is(':checked')) {
-            $('body').addClass(css_class);
-          } else {
-            $('body').removeClass(css_class);
-          }
-        });
-    )"));
-
-    /// JS for collapsing/expanding code for a function
-    body->add(script(R"(
-      $('.function-collapse-btn').click(function(){
-        var button          = $(this);
-        var target_selector = button.data('target');
-        var target          = $(target_selector);
-
-        target.toggleClass('collapsed');
-
-        // TODO: find a way to do the folding/unfolding in CSS
-        if (target.hasClass('collapsed')) {
-          target.find('.function-code').slideUp();
-        } else {
-          target.find('.function-code').slideDown();
-        }
-      });
-
-      // collapse all button
-      $('#control-bar #collapse-all-btn').click(function(){
-        $(this).toggleClass('collapsed');
-
-        if ($(this).hasClass('collapsed')) {
-          $('.function').addClass('collapsed');
-          $('.function-code').slideUp();
-        } else {
-          $('.function').removeClass('collapsed');
-          $('.function-code').slideDown();
-        }
-      });
-    )"));
-
-    /// JS for showing overlay with image of function CFG
-    body->add(script(R"(
-      $('.function-name').click(function(){
-        $('#cfg-overlay').css('height', "100%");
-      });
-
-      $('.cfg-overlay-closer').click(function(){
-        $('#cfg-overlay').css('height', "0%");
-      });
-    )"));
-
-    body->add(new VerbatimTag("div", R"XO(
-      <svg height="130" width="500">
-        <defs>
-          <linearGradient id="grad1" x1="0%" y1="0%" x2="100%" y2="0%">
-            <stop offset="0%"   style="stop-color:rgb(255,255,0);stop-opacity:1" />
-            <stop offset="100%" style="stop-color:rgb(255,0,0);stop-opacity:1" />
-          </linearGradient>
-        </defs>
-        <ellipse cx="100" cy="70" rx="85" ry="55" fill="url(#grad1)" />
-           <text fill="#ffffff" font-size="45" font-family="Verdana" x="50" y="86">
-             <a xlink:href="#_at_main2" class="cfg-overlay-closer">Nyaah!</a>
-           </text>
-           Sorry, your browser does not support inline SVG.
-      </svg>
-    )XO"));
-
-    for (auto& renderer: _renderers) {
-      if (auto code = renderer->addJs()) {
-        body->add(script(*code));
-      }
+      TimeTrace::Scope span{"analyses"};
+      analyses.recalculate(fn);
     }
+    names().types().beginFunction();
 
-    doc->add(body);
-
-    doc->print(OS, 0);
-
-    return false;
-  }
-private:
-  Html* emitFunction(Function& fn) {
-    analyses.recalculate(fn);
-
+    /// remember which renderer every column & styler comes from, see TimeTrace
     _attrs.clear();
-    for (auto& renderer : _renderers)
+    _attr_names.clear();
+    for (auto& renderer : _renderers) {
+      size_t first = _attrs.size();
       renderer->createRenderers(analyses, _attrs);
 
+      for (size_t idx = first; idx < _attrs.size(); idx++)
+        _attr_names.push_back(renderer->columnName(idx - first));
+    }
+
     _basic_block_stylers.clear();
-    for (auto& renderer : _renderers)
+    _styler_names.clear();
+    for (auto& renderer : _renderers) {
       renderer->createBasicBlockStylers(analyses, _basic_block_stylers);
+      _styler_names.resize(_basic_block_stylers.size(), renderer->name());
+    }
 
     auto main = html::div(
       css_class("function expanded"),
@@ -1054,8 +1599,10 @@ private:
       for (auto &block : fn) {
         auto *tbody = emitBasicBlock(block);
 
-        for (auto &styler : _basic_block_stylers)
-          styler->style(block, tbody);
+        for (size_t idx = 0; idx < _basic_block_stylers.size(); idx++) {
+          TimeTrace::Scope span{"style " + _styler_names[idx]};
+          _basic_block_stylers[idx]->style(block, tbody);
+        }
 
         block_table->add(tbody);
         block_table->add(tr());
@@ -1064,7 +1611,20 @@ private:
       fn_html->add(block_table);
     }
 
+    for (size_t idx = 0; idx < _attrs.size(); idx++) {
+      TimeTrace::Scope span{"column " + _attr_names[idx]};
+
+      if (auto footer = _attrs[idx]->renderFooter())
+        fn_html->add(footer);
+    }
+
     main->add(fn_html);
+
+    /// long type names used as mouseover text are looked up in here, see TypeNames
+    auto types = names().types().functionTable();
+    if (!types.empty())
+      main->addAttr(data_attr("types", types));
+
     return main;
   }
 
@@ -1139,8 +1699,19 @@ private:
       body->add(row);
     }
 
+    /// every column renders all of its cells at once, rows are put together from them afterwards
+    _cells.clear();
+    for (size_t idx = 0; idx < _attrs.size(); idx++) {
+      TimeTrace::Scope span{"column " + _attr_names[idx]};
+
+      LLVM_ATTRIBUTE_UNUSED size_t before = _cells.size();
+      _attrs[idx]->renderBlock(bb, _cells);
+      assert((_cells.size() - before == bb.size()) && "renderer has to print exactly one cell per instruction");
+    }
+
+    size_t idx = 0;
     for (auto& inst : bb)
-      body->addChild(emitInstruction(inst));
+      body->addChild(emitInstruction(inst, idx++, bb.size()));
 
     body->add(
       tbody(
@@ -1151,7 +1722,9 @@ private:
     return body;
   }
 
-  SimpleTag* emitInstruction(Instruction& inst) {
+  /// @param idx         position of @p inst in its block
+  /// @param block_size  number of instructions in the block, the cells of one column are this far apart in _cells
+  SimpleTag* emitInstruction(Instruction& inst, size_t idx, size_t block_size) {
     auto row = html::tr();
 
     row->addClass("instruction");
@@ -1161,12 +1734,16 @@ private:
 
     assert(!_attrs.empty());
 
-    /// let renderers emit the individual columns for each attribute
-    for (auto& attr : _attrs) {
-      auto elem = attr->render(inst);
-
-      row->addChild(td(elem));
+    /// the row is put together in a buffer that is reused for every row and only then copied into the arena
+    _row.clear();
+    for (size_t col = 0; col < _attrs.size(); col++) {
+      _row += "<td>";
+      _row += _cells.cell(col * block_size + idx);
+      _row += "</td>";
     }
+    if (!_compact)
+      _row += '\n';
+    row->addChild(new RawHtml{_row});
 
     return row;
   }
@@ -1186,13 +1763,7 @@ private:
     return html(*ty);
   }
   HtmlString* html(const Type& ty) {
-    std::string buf;
-    raw_string_ostream OS{buf};
-
-    ty.print(OS, false);
-    OS.flush();
-
-    return html::str(buf);
+    return html::str(names().types().name(&ty));
   }
   Html* html(Html* html) {
     return html;
@@ -1215,68 +1786,1540 @@ private:
 
   Analyses analyses;
 
-  std::vector<std::unique_ptr<Renderer>> _renderers;
+  HtmlArena _fn_arena;
+
+  const std::vector<std::unique_ptr<Renderer>>& _renderers;
+  const RenderCache* _cache;
+  bool _keep_bodies = false;
   std::vector<std::unique_ptr<Renderer::AttributeRenderer>> _attrs;
   std::vector<std::unique_ptr<Renderer::BasicBlockStyler>> _basic_block_stylers;
+  std::vector<StringRef> _attr_names;   // names of the columns in _attrs, see Renderer::columnName()
+  std::vector<StringRef> _styler_names; // names of the renderers the stylers in _basic_block_stylers come from
+  Renderer::CellBuffer _cells; // cells of the block being rendered, see emitBasicBlock()
+  SmallString<256>     _row;   // HTML of the cells of the row being rendered, see emitInstruction()
+  bool                 _compact = false; // function is printed without indentation, see Html::FLOW_STYLE
 };
 
-int main(int argc, const char * const* argv) {
-  sys::PrintStackTraceOnErrorSignal(argv[0]);
-  PrettyStackTraceProgram X{argc, argv};
+struct HtmlPrinter {
+  /// Loads another copy of the module we print into a different context, same IR as the module itself.
+  using ModuleLoader = std::function<std::unique_ptr<Module>(LLVMContext&)>;
 
-  LLVMContext Context;
+  /// @param loader       used to load copies of @p m for rendering functions in parallel
+  /// @param num_threads  number of threads for rendering functions
+  HtmlPrinter(Module& m, ModuleLoader loader = nullptr, unsigned num_threads = 1)
+  : _module{m}
+  , _loader{loader}
+  , _num_threads{num_threads}
+  {}
 
-  cl::ParseCommandLineOptions(argc, argv, "LLVM-IR HTML visualizer\n");
+  /// Only render some functions of the module, @p selected holds a flag for every function in module order.
+  /// See selectFunctions().
+  void setSelection(std::vector<bool> selected) {
+    assert(selected.size() == _module.size());
+    _selected = std::move(selected);
+  }
 
-  // Load IR of the module to be compiled...
-  std::unique_ptr<Module> M = [&](){
-    SMDiagnostic Err;
-    auto M = parseIRFile(InputFilename, Err, Context);
-    if (!M) {
-      Err.print(argv[0], errs());
-      exit(1);
-    }
-    return M;
-  }();
+  /// Only render the instruction table columns with the given names, see Renderer::name().
+  /// Columns always appear in the same order, no matter in which order they are given. Empty means all of them.
+  void setColumns(std::vector<std::string> columns) {
+    _columns = std::move(columns);
+  }
 
-#if 0
-  ModuleSlotTracker slots{&*M};
-  InstructionNamer namer{slots};
+  /// Use short IDs based on the position of values instead of their names, see ValueNameMangler::setNumericIds().
+  void setNumericIds(bool numeric) {
+    _numeric_ids = numeric;
+  }
 
-  for (auto& fn : *M) {
-    if (fn.isDeclaration())
-      continue;
+  /// All renderers that add columns to the instruction table, in the order the columns appear.
+  /// @param selected  names of the columns that are rendered, empty means all of them
+  /// @param sources   see DebugLocRenderer
+  static std::vector<std::unique_ptr<Renderer>> createColumnRenderers(const std::vector<std::string>& selected = {},
+                                                                      SourceIndex* sources = nullptr) {
+    std::vector<std::unique_ptr<Renderer>> columns;
 
-    DominatorTree domTree{fn};
-    LoopInfo loops{domTree};
+    std::unique_ptr<BuiltinColumns> builtin{new BuiltinColumns{selected}};
+    if (!builtin->empty())
+      columns.push_back(std::move(builtin));
 
-    outs() << "// " << fn.getName() << "\n";
-    outs() << "\n";
-    cfg2dot(outs(), fn, namer, loops);
+    for (auto& renderer : createDynamicColumnRenderers(sources)) {
+      if (selected.empty() || is_contained(selected, renderer->name()))
+        columns.push_back(std::move(renderer));
+    }
+
+    return columns;
+  }
+
+  /// Names of all columns of the instruction table, in the order they appear.
+  static std::vector<std::string> columnNames() {
+    std::vector<std::string> names;
+
+    for (auto name : BuiltinColumns::names())
+      names.push_back(name);
+    for (auto& renderer : createDynamicColumnRenderers())
+      names.push_back(renderer->name().str());
+
+    return names;
+  }
+
+  /// Write jQuery & co. to directory @p dir instead of embedding them in pages or copying them into output directories.
+  /// Files are named after a hash of their contents, so pages of any number of runs can share them
+  /// and a file that already exists is never written again.
+  /// @param url  prefix pages use for linking to files in @p dir
+  void setAssetDirectory(StringRef dir, StringRef url) {
+    _asset_dir = dir;
+
+    for (auto& asset : Assets) {
+      MD5 md5;
+      md5.update(asset.source());
+
+      MD5::MD5Result result;
+      md5.final(result);
+
+      SmallString<32> hex;
+      MD5::stringifyResult(result, hex);
+
+      StringRef file = asset.file;
+      std::string name = (sys::path::stem(file) + "." + hex.str().substr(0, 16) + sys::path::extension(file)).str();
+
+      _asset_files[file] = name;
+      _asset_urls[file]  = (url.endswith("/") ? url + name : url + "/" + name).str();
+    }
+  }
+
+  /// Print pages without any indentation or line breaks between tags, see Html::FLOW_STYLE.
+  void setCompact(bool compact) {
+    _compact = compact;
+  }
+
+  /// Embed jQuery & co. gzip compressed in pages that do not link to them, the browser inflates them.
+  /// Needs a browser that supports DecompressionStream.
+  void setGzipAssets(bool gzip) {
+    _gzip_assets = gzip;
+  }
+
+  /// Gzip compress the files written by runSharded(), see GzipStream.
+  /// The single page written by run() is compressed by passing it a GzipStream.
+  void setCompress(bool compress) {
+    _compress = compress;
+  }
+
+  /// Show the source code instructions come from next to every function, see DebugLocRenderer.
+  void setShowSource(bool show) {
+    _sources.reset(show ? new SourceIndex : nullptr);
+  }
+
+  /// Store the HTML of rendered functions in directory @p dir and reuse it in later runs, see RenderCache.
+  void setCacheDirectory(StringRef dir) {
+    _cache_dir = dir;
+  }
+
+  /// Print the whole module as a single HTML page.
+  bool run(raw_ostream& OS) {
+    registerRenderers();
+    initConfig();
+    writeAssets();
+
+    /// Nodes for the page skeleton live until the whole page is printed,
+    /// each function gets its own arena in emitFunction.
+    HtmlArena::Scope doc_scope{_doc_arena};
+
+    /// The page is streamed out piece by piece:
+    /// everything before the first function is printed before any function is analysed,
+    /// each function is printed and dropped as soon as it has been rendered,
+    /// and the trailing scripts come last.
+
+    {
+      TimeTrace::Scope span{"page start"};
+      emitPageStart(OS);
+    }
+    emitFunctions(OS);
+    {
+      TimeTrace::Scope span{"page end"};
+      emitPageEnd(OS);
+    }
+
+    return false;
+  }
+
+  /// Maps the file names of the pages of sharded output to hashes of what is on them.
+  using ShardHashes = StringMap<std::string>;
+
+  /// Print every function to its own page in directory @p dir, plus an index page with links to all of them.
+  /// jQuery & Bootstrap are written to shared files next to the pages instead of being inlined into every one.
+  ///
+  /// If @p shards is set, @p dir is updated incrementally: @p shards describes the pages already in @p dir.
+  /// Only pages of functions that changed are written, pages of functions that are gone are deleted,
+  /// and @p shards is updated to match the new contents of @p dir.
+  /// Every file is replaced atomically and the index is updated after the pages it links to,
+  /// so the directory is consistent at any point in time.
+  bool runSharded(StringRef dir, ShardHashes* shards = nullptr) {
+    registerRenderers();
+
+    _sharded = true;
+
+    initConfig();
+
+    HtmlArena::Scope doc_scope{_doc_arena};
+
+    if (auto EC = sys::fs::create_directories(dir)) {
+      errs() << "llvm-viz: Could not create output directory `" << dir << "': " << EC.message() << '\n';
+      exit(1);
+    }
+
+    writeAssets();
+
+    if (_asset_dir.empty() && (!shards || shards->empty())) {
+      for (auto& asset : Assets)
+        writeFile(dir, asset.file, [&](raw_ostream& OS) { OS << asset.source(); });
+    }
+
+    /// all pages share the same skeleton, so we only render it once.
+    std::string page_start, page_end;
+    {
+      raw_string_ostream OS{page_start};
+      emitPageStart(OS);
+    }
+    {
+      raw_string_ostream OS{page_end};
+      emitPageEnd(OS);
+    }
+
+    /// rendering drops the bodies of lazily loaded functions, so which functions get a page is decided up front
+    auto index = indexEntries();
+
+    /// the body is loaded before the file is created, so a function that can not be loaded leaves no broken page behind
+    auto writeShard = [&](FunctionPrinter& printer, Function& fn, StringRef file) -> Error {
+      return printer.withBody(fn, [&]() {
+        writeFile(dir, file, [&](raw_ostream& OS) {
+          OS << page_start;
+          cantFail(printer.emitFunction(fn, OS, indent(CONTENT_INDENT)));
+          OS << page_end;
+        });
+      });
+    };
+
+    if (!shards) {
+      forEachFunction([&](FunctionPrinter& printer, Function& fn, size_t) {
+        return writeShard(printer, fn, printer.names().shardFileName(fn));
+      });
+
+      writeFile(dir, "index.html", [&](raw_ostream& OS) {
+        emitIndex(OS, index);
+      });
+      return false;
+    }
+
+    /// the page skeleton is part of every page, so it goes into the hash as well.
+    std::string page_config = _config + '\n' + page_start + page_end;
+
+    /// new contents of the directory, by job
+    std::vector<std::pair<std::string, std::string>> written(numFunctions());
+    std::atomic<size_t>                              num_changed{0};
+
+    forEachFunction([&](FunctionPrinter& printer, Function& fn, size_t job) {
+      std::string file = printer.names().shardFileName(fn);
+
+      return printer.withBody(fn, [&]() {
+        std::string hash = hashFunction(fn, page_config + '\n' + printer.describeInputs(fn), indent(CONTENT_INDENT),
+                                        printer.slots(), printer.names());
+
+        /// nobody modifies shards while we render, so reading it from multiple threads is fine.
+        auto it = shards->find(file);
+
+        if ((it == shards->end()) || (it->second != hash)) {
+          cantFail(writeShard(printer, fn, file)); // the body is loaded already
+          num_changed++;
+        }
+
+        written[job] = {std::move(file), std::move(hash)};
+      });
+    });
+
+    writeFile(dir, "index.html", [&](raw_ostream& OS) {
+      emitIndex(OS, index);
+    });
+
+    ShardHashes current;
+    for (auto& shard : written)
+      current[shard.first] = std::move(shard.second);
+
+    for (auto& shard : *shards) {
+      if (current.count(shard.getKey()))
+        continue;
+
+      SmallString<128> path{dir};
+      sys::path::append(path, shard.getKey());
+      if (_compress)
+        path += ".gz";
+      sys::fs::remove(path);
+    }
+
+    errs() << "llvm-viz: Updated " << num_changed << " of " << written.size() << " functions\n";
+
+    *shards = std::move(current);
+    return false;
+  }
+  /// Serve the module over HTTP on localhost, see HttpServer. Functions are only rendered when the browser asks for them.
+  ///
+  /// The start page has the control bar & a list of all functions, clicking one loads its code into the page.
+  /// Every function also has a page of its own, named like the pages of sharded output, which is where links lead to.
+  /// The HTML of rendered functions is kept in an LRU cache, the IR of lazily loaded functions stays loaded once
+  /// they were rendered, so rendering them again after their HTML was evicted costs no parsing.
+  /// Each gets half of @p cache_bytes. Once the loaded IR takes up more than that, we start over with a fresh copy
+  /// of the module without any function bodies, so the whole module is only parsed again once in a while.
+  [[noreturn]] void runServer(StringRef address, size_t cache_bytes) {
+    registerRenderers();
+
+    /// pages link to each other & to the shared asset files just like sharded output
+    _sharded = true;
+    _serving = true;
+
+    initConfig();
+
+    HtmlArena::Scope doc_scope{_doc_arena};
+
+    std::string page_start, page_end;
+    {
+      raw_string_ostream OS{page_start};
+      emitPageStart(OS);
+    }
+    {
+      raw_string_ostream OS{page_end};
+      emitPageEnd(OS);
+    }
+
+    /// The module functions are rendered from, all on the main thread.
+    /// Starts out as the module itself, later copies come from _loader, see ModuleLoader.
+    struct Copy {
+      LLVMContext                      ctx;
+      std::unique_ptr<Module>          module;    // null for the module itself
+      std::vector<Function*>           functions; // by position in the module
+      std::unique_ptr<FunctionPrinter> printer;
+    };
+
+    std::unique_ptr<Copy> copy;
+
+    auto loadCopy = [&]() {
+      bool fresh = (copy != nullptr);
+
+      /// the old copy goes first, there is only ever one in memory
+      copy.reset(new Copy);
+
+      Module* module = &_module;
+
+      if (fresh) {
+        copy->module = _loader(copy->ctx);
+        module       = copy->module.get();
+
+        assert(module && "copies are parsed from the same input as the module itself");
+      }
+
+      for (auto& fn : *module)
+        copy->functions.push_back(&fn);
+
+      copy->printer.reset(new FunctionPrinter{*module, _renderers, _sharded, _selected, _cache.get()});
+      copy->printer->names().setNumericIds(_numeric_ids);
+      copy->printer->setKeepBodies(true);
+    };
+
+    loadCopy();
+
+    /// functions by the file name of their page, as their position in the module
+    StringMap<unsigned> functions;
+
+    std::string start_page = page_start;
+    {
+      raw_string_ostream OS{start_page};
+
+      size_t idx = 0;
+      for (auto& fn : _module) {
+        if (!isSelected(fn, idx++))
+          continue;
+
+        std::string file = copy->printer->names().shardFileName(fn);
+        functions[file]  = idx - 1;
+
+        div(
+          css_class("function-stub"),
+          data_attr("src", "fragment/" + file),
+          tag("h1", a(css_class("function-loader"), attr("href", file), fn.getName()))
+        )->print(OS, indent(CONTENT_INDENT));
+      }
+
+      OS << page_end;
+    }
+
+    LruCache fragments{cache_bytes / 2};
+
+    /// estimated size of the function bodies loaded into the current copy
+    size_t body_bytes = 0;
+
+    auto renderFragment = [&](StringRef file) -> Optional<std::string> {
+      auto it = functions.find(file);
+      if (it == functions.end())
+        return None;
+
+      if (auto html = fragments.lookup(file))
+        return *html;
+
+      /// rendering loads another function body, drop all of them first if they take up too much memory already.
+      /// Without a loader there is no way to get rid of them.
+      if (copy->functions[it->second]->isMaterializable() && (body_bytes > cache_bytes / 2) && _loader) {
+        loadCopy();
+        body_bytes = 0;
+      }
+
+      Function& fn = *copy->functions[it->second];
+      bool lazy = fn.isMaterializable();
+
+      std::string html;
+      raw_string_ostream OS{html};
+
+      exitOnError(copy->printer->emitFunction(fn, OS, indent(CONTENT_INDENT)));
+      OS.flush();
+
+      if (lazy) {
+        for (auto& bb : fn)
+          body_bytes += IR_BYTES_PER_INSTRUCTION() * bb.size();
+      }
+
+      fragments.insert(file, html);
+      return html;
+    };
+
+    HttpServer server{address};
+
+    errs() << "llvm-viz: Serving `" << _module.getModuleIdentifier() << "' on " << server.url() << "\n";
+
+    server.serve([&](StringRef path, HttpServer::Response& response) {
+      StringRef file = path.drop_front();
+
+      if (file.empty() || (file == "index.html")) {
+        response.body = start_page;
+      } else if (file == JQueryFile) {
+        response.content_type = "application/javascript";
+        response.body         = jQuerySource().str();
+      } else if (file == BootstrapJsFile) {
+        response.content_type = "application/javascript";
+        response.body         = BootstrapJsSource().str();
+      } else if (file == BootstrapCssFile) {
+        response.content_type = "text/css";
+        response.body         = BootstrapCssSource().str();
+      } else if (file.consume_front("fragment/")) {
+        if (auto html = renderFragment(file))
+          response.body = std::move(*html);
+        else
+          response.status = 404;
+      } else if (auto html = renderFragment(file)) {
+        response.body = page_start + *html + page_end;
+      } else {
+        response.status = 404;
+      }
+    });
+  }
+private:
+  /// Writes the assets that are not in the asset directory yet, see setAssetDirectory().
+  void writeAssets() {
+    if (_asset_dir.empty())
+      return;
+
+    if (auto EC = sys::fs::create_directories(_asset_dir)) {
+      errs() << "llvm-viz: Could not create asset directory `" << _asset_dir << "': " << EC.message() << '\n';
+      exit(1);
+    }
+
+    for (auto& asset : Assets) {
+      StringRef file = _asset_files[asset.file];
+
+      SmallString<128> path{_asset_dir};
+      sys::path::append(path, file);
+      if (_compress)
+        path += ".gz";
+
+      if (!sys::fs::exists(path))
+        writeFile(_asset_dir, file, [&](raw_ostream& OS) { OS << asset.source(); });
+    }
+  }
+
+  /// Script that inflates the gzip compressed assets embedded in the page, see setGzipAssets().
+  /// Inflating is asynchronous, so all other @p scripts are only run once the assets are loaded.
+  Html* emitAssetLoader(ArrayRef<Html*> scripts) {
+    static constexpr const char DEFERRED[] = "text/x-llvm-viz-deferred";
+
+    for (auto html : scripts) {
+      auto tag = dyn_cast<VerbatimTag>(html);
+
+      if (tag && (tag->tag() == "script"))
+        tag->addAttr("type", DEFERRED);
+    }
+
+    std::string js;
+    raw_string_ostream OS{js};
+
+    OS << R"(
+      (async function() {
+        async function inflate(data) {
+          var bytes  = Uint8Array.from(atob(data), function(c) { return c.charCodeAt(0); });
+          var stream = new Blob([bytes]).stream().pipeThrough(new DecompressionStream('gzip'));
+          return new Response(stream).text();
+        }
+        function run(code) {
+          var script = document.createElement('script');
+          script.text = code;
+          document.body.appendChild(script);
+        }
+
+        var css = document.createElement('style');
+        css.textContent = await inflate(')" << base64(BootstrapCssSourceGzip()) << R"(');
+        document.head.appendChild(css);
+
+        run(await inflate(')" << base64(jQuerySourceGzip()) << R"('));
+        run(await inflate(')" << base64(BootstrapJsSourceGzip()) << R"('));
+
+        document.querySelectorAll('script[type=")" << DEFERRED << R"("]').forEach(function(script) {
+          run(script.text);
+        });
+      })();
+    )";
+
+    return script(OS.str());
+  }
+
+  static std::string base64(StringRef data) {
+    static const char DIGITS[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+    std::string out;
+    out.reserve((data.size() + 2) / 3 * 4);
+
+    for (size_t i = 0; i < data.size(); i += 3) {
+      uint32_t bits = uint32_t(uint8_t(data[i])) << 16;
+      if (i + 1 < data.size())
+        bits |= uint32_t(uint8_t(data[i + 1])) << 8;
+      if (i + 2 < data.size())
+        bits |= uint32_t(uint8_t(data[i + 2]));
+
+      out += DIGITS[(bits >> 18) & 63];
+      out += DIGITS[(bits >> 12) & 63];
+      out += (i + 1 < data.size()) ? DIGITS[(bits >> 6) & 63] : '=';
+      out += (i + 2 < data.size()) ? DIGITS[bits & 63] : '=';
+    }
+    return out;
+  }
+
+  /// Pages link to assets instead of embedding them.
+  bool externalAssets() const {
+    return _sharded || !_asset_dir.empty();
+  }
+
+  /// Where pages find the asset that is called @p file in output directories.
+  std::string assetUrl(StringRef file) const {
+    auto it = _asset_urls.find(file);
+    return (it != _asset_urls.end()) ? it->second : file.str();
+  }
+
+  static constexpr const unsigned HTML_INDENT    = 0;
+  static constexpr const unsigned BODY_INDENT    = 2; // <head> & <body>
+  static constexpr const unsigned CONTENT_INDENT = 4; // everything in the <body>, including functions
+
+  /// Indent for printing HTML that belongs at level @p level, none at all in compact mode.
+  unsigned indent(unsigned level) const {
+    return _compact ? Html::FLOW_STYLE : level;
+  }
+
+  /// Renderers of the columns that are not in BuiltinColumns, because they need more than a simple function per cell.
+  static std::vector<std::unique_ptr<Renderer>> createDynamicColumnRenderers(SourceIndex* sources = nullptr) {
+    std::vector<std::unique_ptr<Renderer>> columns;
+
+    columns.emplace_back(new DebugLocRenderer{sources});
+    columns.emplace_back(new ScevRenderer{});
+    columns.emplace_back(new MetadataRenderer{});
+
+    return columns;
+  }
+
+  void registerRenderers() {
+    /// Register renderers for instruction attributes we visualize.
+    /// Columns that were not asked for are not even created, so they cost nothing, not even their analyses.
+    for (auto& renderer : createColumnRenderers(_columns, _sources.get()))
+      _renderers.push_back(std::move(renderer));
+
+    _renderers.emplace_back(new LoopDepthStyler{});
+    _renderers.emplace_back(new HideCodeStyler{});
+  }
+
+  /// Describe everything that affects how functions are rendered, see hashFunction(), and open the cache if we use one.
+  void initConfig() {
+    raw_string_ostream OS{_config};
+
+    for (auto& renderer : _renderers)
+      OS << renderer->name() << ',';
+    OS << (_sharded ? "sharded" : "single-page");
+    if (_numeric_ids)
+      OS << ",numeric-ids";
+    if (_sources)
+      OS << ",source";
+    if (_compact)
+      OS << ",compact";
+    OS.flush();
+
+    if (!_cache_dir.empty())
+      _cache.reset(new RenderCache{_cache_dir, _config});
+  }
+
+  /// Everything up to the first function: <head>, control bar, etc.
+  void emitPageStart(raw_ostream& OS) {
+    OS << "<!DOCTYPE html>\n";
+
+    tag("html", attr("lang", "en"))->printOpen(OS, indent(HTML_INDENT));
+
+    emitHead()->print(OS, indent(BODY_INDENT));
+
+    auto body = tag("body");
+
+    /// the control bar decides the initial CSS classes of the body, so render it before opening the body.
+    auto control_bar = emitControlBar(body);
+
+    body->printOpen(OS, indent(BODY_INDENT));
+
+    control_bar->print(OS, indent(CONTENT_INDENT));
+    emitCfgOverlay()->print(OS, indent(CONTENT_INDENT));
+  }
+
+  /// Everything after the last function: scripts & closing tags.
+  void emitPageEnd(raw_ostream& OS) {
+    for (auto html : emitScripts())
+      html->print(OS, indent(CONTENT_INDENT));
+
+    tag("body")->printClose(OS, indent(BODY_INDENT));
+    tag("html")->printClose(OS, indent(HTML_INDENT));
+  }
+
+  /// A function on the index page of sharded output.
+  struct IndexEntry {
+    std::string name; // name of the function
+    std::string file; // name of its page, see ValueNameMangler::shardFileName()
+  };
+
+  /// All functions that get a page of their own, in module order.
+  /// Has to be called before rendering, which drops the bodies of lazily loaded functions (see isSelected()).
+  std::vector<IndexEntry> indexEntries() {
+    ModuleSlotTracker slots{&_module};
+    ValueNameMangler  names{slots};
+
+    std::vector<IndexEntry> entries;
+
+    size_t idx = 0;
+    for (auto& fn : _module) {
+      if (isSelected(fn, idx++))
+        entries.push_back(IndexEntry{fn.getName().str(), names.shardFileName(fn)});
+    }
+
+    return entries;
+  }
+
+  /// Page with links to the pages of all functions, for sharded output.
+  /// @param entries  functions to list, see indexEntries()
+  void emitIndex(raw_ostream& OS, const std::vector<IndexEntry>& entries) {
+    auto head = tag(
+      "head",
+      meta(attr("charset", "utf-8")),
+      stylesheet(assetUrl(BootstrapCssFile)),
+      tag("title", _module.getModuleIdentifier())
+    );
+
+    auto functions = table(css_class("table"));
+
+    for (auto& entry : entries) {
+      functions->add(
+        tr(
+          td(a(attr("href", entry.file), entry.name))
+        )
+      );
+    }
+
+    auto body = tag(
+      "body",
+      tag("h1", _module.getModuleIdentifier()),
+      functions
+    );
+
+    OS << "<!DOCTYPE html>\n";
+
+    tag("html", attr("lang", "en"), head, body)->print(OS, indent(HTML_INDENT));
+  }
+
+  /// Creates @p filename in @p dir and lets @p print fill it.
+  /// The file is written to a temporary file first and moved into place once complete,
+  /// so nobody looking at the directory, like a browser reloading a page, ever sees a half written file.
+  /// When compressing output, the file is gzip compressed and gets a `.gz' suffix.
+  void writeFile(StringRef dir, StringRef filename, function_ref<void(raw_ostream&)> print) {
+    SmallString<128> path{dir};
+    sys::path::append(path, filename);
+    if (_compress)
+      path += ".gz";
+
+    int fd;
+    SmallString<128> tmp;
+
+    if (auto EC = sys::fs::createUniqueFile(Twine(path) + ".tmp-%%%%%%", fd, tmp)) {
+      errs() << "llvm-viz: Could not open output file `" << path << "': " << EC.message() << '\n';
+      exit(1);
+    }
+
+    {
+      raw_fd_ostream OS{fd, true};
+      if (_compress) {
+        /// pages are written by several workers at once already, so every page is compressed on a single thread
+        GzipStream GZ{OS};
+        print(GZ);
+      } else {
+        print(OS);
+      }
+      OS.close();
+
+      if (OS.has_error()) {
+        OS.clear_error();
+        sys::fs::remove(tmp);
+        errs() << "llvm-viz: Could not write output file `" << path << "'\n";
+        exit(1);
+      }
+    }
+
+    if (auto EC = sys::fs::rename(tmp, path)) {
+      sys::fs::remove(tmp);
+      errs() << "llvm-viz: Could not write output file `" << path << "': " << EC.message() << '\n';
+      exit(1);
+    }
+  }
+
+  SimpleTag* emitHead() {
+    auto head = tag("head");
+
+    head->add(
+      meta(attr("charset", "utf-8")),
+      meta(attr("http-equiv", "X-UA-Compatible"), attr("content", "IE=edge")),
+      meta(attr("name", "viewport"), attr("content", "width=device-width, initial-scale=1")),
+      meta(attr("name", "description"), attr("content", "llvm-IR visualization")),
+      meta(attr("name", "author"), attr("content", "Fader A. Vader"))
+    );
+
+    head->add(style(R"(
+      /******************************************/
+      /* general table styles */
+
+      th { text-align: center; }
+
+
+      /******************************************/
+      /* collapsable code for function */
+
+      /*
+       * the collapse/expand `button' is implemented as a link,
+       * disable underlining and selection to make it feel more like a button
+       */
+      .function-collapse-btn, .function-expand-btn {
+         margin-left: 0.5em;
+         text-decoration: none !important;
+         -moz-user-select: none;
+      }
+
+      .function           .expander  { display: none; }
+      .function.collapsed .expander  { display: inline; }
+      .function.collapsed .collapser { display: none; }
+
+      #collapse-all-btn           .expander  { display: none; }
+      #collapse-all-btn.collapsed .expander  { display: inline; }
+      #collapse-all-btn.collapsed .collapser { display: none; }
+
+
+      /******************************************/
+      /* collapsable overlay for showing CFG */
+
+      /* The Overlay (background) */
+      #cfg-overlay {
+          /* Height & width depends on how you want to reveal the overlay (see JS below) */
+          height: 0;
+          width: 100%;
+          position: fixed; /* Stay in place */
+          z-index: 200;    /* Sit on top */
+          left: 0;
+          top: 0;
+          background-color: rgb(0,0,0); /* Black fallback color */
+          background-color: rgba(0,0,0, 0.9); /* Black w/opacity */
+          overflow-x: hidden; /* Disable horizontal scroll */
+          transition: 0.5s; /* 0.5 second transition effect to slide in or slide down the overlay (height or width, depending on reveal) */
+      }
+
+      /* Position the content inside the overlay */
+      #cfg-overlay-content {
+          position: relative;
+          top: 25%; /* 25% from the top */
+          width: 100%; /* 100% width */
+          text-align: center; /* Centered text/links */
+          margin-top: 30px; /* 30px top margin to avoid conflict with the close button on smaller screens */
+      }
+
+      /* The navigation links inside the overlay */
+      #cfg-overlay a {
+          padding: 8px;
+          text-decoration: none;
+          font-size: 36px;
+          color: #818181;
+          display: block; /* Display block instead of inline */
+          transition: 0.3s; /* Transition effects on hover (color) */
+      }
+
+      /* When you mouse over the navigation links, change their color */
+      #cfg-overlay a:hover, #cfg-overlay a:focus {
+          color: #f1f1f1;
+      }
+
+      /* Position the close button (top right corner) */
+      #cfg-overlay-closebtn {
+          position: absolute;
+          top:      2ex;
+          right:    2em;
+      }
+
+      /*
+       * When the height of the screen is less than 450 pixels, change the
+       * font-size of the links and position the close button again,
+       * so they don't overlap
+       */
+      @media screen and (max-height: 450px) {
+          #cfg-overlay a {font-size: 20px}
+          #cfg-overlay-closebtn {
+              font-size: 40px !important;
+              top: 15px;
+              right: 35px;
+          }
+      }
+
+      .cfg-image {
+          display: none;
+      }
+
+      /******************************************/
+      /* fixed position bar on top of page with checkboxes for enabling/disabling display flags */
+
+      #control-bar {
+          position: fixed;
+          top: 0;
+          right: 0;
+          z-index: 100;
+          background-color: rgb(220,220,220);
+          border-radius: 0 0 0 1em;
+          padding: 2em;
+          width: auto;
+      }
+
+      #control-bar th {
+        text-align: center;
+      }
+    )"));
+    if (externalAssets()) {
+      head->add(stylesheet(assetUrl(BootstrapCssFile)));
+    } else if (!_gzip_assets) {
+      head->add(style(BootstrapCssSource())->preformatted());
+    }
+
+    for (auto& renderer: _renderers) {
+      if (auto code = renderer->addCss()) {
+        head->add(style(*code));
+      }
+    }
+
+    head->add(tag("title", _module.getModuleIdentifier()));
+
+    return head;
+  }
+
+  /// Render control bar which contains buttons & checkboxes for various flags & display actions
+  /// Adds CSS classes for the initially checked flags to @p body.
+  SimpleTag* emitControlBar(SimpleTag* body) {
+    std::vector<Renderer::ControlCheckbox> checkboxes;
+    std::vector<Renderer::ControlButton>   buttons;
+
+    auto control_bar = table(css_id("control-bar"), css_class("table"));
+
+    /// Render fold all functions button
+    {
+      auto fold_all = a(
+        css_id("collapse-all-btn"),
+        css_class("btn-link"),
+        attr("href", "javascript:void(0)"),
+        span(css_class("collapser"), "Collapse all functions"),
+        span(css_class("expander"), "Expand all functions")
+      );
+
+      control_bar->add(
+        tr(
+          th(
+            attr("colspan", 2),
+            css_class("control-bar-control"),
+            fold_all
+          )
+        )
+      );
+    }
+
+    control_bar->add(tr());
+
+    /// Render checkboxes for various display flags
+    {
+      for (auto& renderer : _renderers) {
+        renderer->addControlCheckboxes(checkboxes);
+        renderer->addControlButtons(buttons);
+      }
+
+      for (auto& button : buttons) {
+        control_bar->add(
+          tr(
+            th(
+              attr("colspan", 2),
+              html::a(
+                css_id(button.css_id),
+                button.display_name
+              )
+            )
+          )
+        );
+      }
+
+      control_bar->add(tr());
+
+      for (auto& flag : checkboxes) {
+        auto checkbox = html::input(
+          "checkbox",
+          css_id(flag.css_id),
+          attr("data-flag", flag.css_id)
+        );
+
+        if (flag.initially_checked) {
+          body->addClass(flag.css_id);
+          checkbox->addAttr("checked");
+        }
+
+        control_bar->add(
+          tr(
+            th(checkbox),
+            th(flag.display_name)
+          )
+        );
+      }
+    }
+
+    return control_bar;
+  }
+
+  /// add overlay for displaying function CFG
+  SimpleTag* emitCfgOverlay() {
+    /**
+     * Important elements classes:
+     *  - #cfg-overlay .......... container for the whole overlay the CFG image is shown here
+     *  - .cfg-overlay-closer ... any link with this class closes the overlay when clicked.
+     */
+
+    auto overlay = div(
+      attr("id", "cfg-overlay"),
+
+      /// close button for the overlay
+      // <a href="javascript:void(0)" class="closebtn" onclick="closeNav()">&times;</a>
+      html::a(
+        css_id("cfg-overlay-closebtn"),
+        css_class("cfg-overlay-closer btn-large btn-link"),
+        attr("href", "javascript:void(0)"),
+        html::times(), "close"
+      ),
+
+      /// overlay content
+      html::div(
+        css_id("cfg-overlay-content"),
+        new VerbatimTag("div", R"XO(
+          <svg >
+            <defs>
+              <linearGradient id="grad1" x1="0%" y1="0%" x2="100%" y2="0%">
+                <stop offset="0%"   style="stop-color:rgb(255,255,0);stop-opacity:1" />
+                <stop offset="100%" style="stop-color:rgb(255,0,0);stop-opacity:1" />
+              </linearGradient>
+            </defs>
+            <ellipse cx="100" cy="70" rx="85" ry="55" fill="url(#grad1)" />
+               <text fill="#ffffff" font-size="45" font-family="Verdana" x="50" y="86">
+                 <a xlink:href="#_at_main2" class="cfg-overlay-closer">main2</a>
+               </text>
+               Sorry, your browser does not support inline SVG.
+          </svg>
+        )XO")
+      )
+    );
+
+    return overlay;
+  }
+
+  /// Scripts & co. at the end of the body
+  std::vector<Html*> emitScripts() {
+    std::vector<Html*> scripts;
+
+    if (externalAssets()) {
+      scripts.push_back(external_script(assetUrl(JQueryFile)));
+      scripts.push_back(external_script(assetUrl(BootstrapJsFile)));
+    } else if (!_gzip_assets) {
+      scripts.push_back(script(jQuerySource())->preformatted());
+      scripts.push_back(script(BootstrapJsSource())->preformatted());
+    }
+
+    /// JS for enabling/disabling the display flags from checkboxes in the control-bar
+    scripts.push_back(script(R"(
+        $('#control-bar input:checkbox').change(function(){
+          var css_class = $(this).data('flag');
+
+          if ($(this).is(':checked')) {
+            $('body').addClass(css_class);
+          } else {
+            $('body').removeClass(css_class);
+          }
+        });
+    )"));
+
+    /// JS for collapsing/expanding code for a function
+    scripts.push_back(script(R"(
+      $(document).on('click', '.function-collapse-btn', function(){
+        var button          = $(this);
+        var target_selector = button.data('target');
+        var target          = $(target_selector);
+
+        target.toggleClass('collapsed');
+
+        // TODO: find a way to do the folding/unfolding in CSS
+        if (target.hasClass('collapsed')) {
+          target.find('.function-code').slideUp();
+        } else {
+          target.find('.function-code').slideDown();
+        }
+      });
+
+      // collapse all button
+      $('#control-bar #collapse-all-btn').click(function(){
+        $(this).toggleClass('collapsed');
+
+        if ($(this).hasClass('collapsed')) {
+          $('.function').addClass('collapsed');
+          $('.function-code').slideUp();
+        } else {
+          $('.function').removeClass('collapsed');
+          $('.function-code').slideDown();
+        }
+      });
+    )"));
+
+    /// JS for showing overlay with image of function CFG
+    scripts.push_back(script(R"(
+      $(document).on('click', '.function-name', function(){
+        $('#cfg-overlay').css('height', "100%");
+      });
+
+      $('.cfg-overlay-closer').click(function(){
+        $('#cfg-overlay').css('height', "0%");
+      });
+    )"));
+
+    /// JS for showing long type names, values only refer to them by index into a table of their function
+    scripts.push_back(script(R"(
+      $(document).on('mouseenter', '[data-ty]', function(){
+        if (!this.title) {
+          var types = $(this).closest('.function').data('types');
+          this.title = types[$(this).data('ty')];
+        }
+      });
+    )"));
+
+    /// JS for loading the code of functions into the start page of the server
+    if (_serving) {
+      scripts.push_back(script(R"(
+        $(document).on('click', '.function-stub .function-loader', function(event){
+          event.preventDefault();
+
+          var stub = $(this).closest('.function-stub');
+
+          $.get(stub.data('src'), function(html){
+            stub.replaceWith(html);
+          });
+        });
+      )"));
+    }
+
+    scripts.push_back(new VerbatimTag("div", R"XO(
+      <svg height="130" width="500">
+        <defs>
+          <linearGradient id="grad1" x1="0%" y1="0%" x2="100%" y2="0%">
+            <stop offset="0%"   style="stop-color:rgb(255,255,0);stop-opacity:1" />
+            <stop offset="100%" style="stop-color:rgb(255,0,0);stop-opacity:1" />
+          </linearGradient>
+        </defs>
+        <ellipse cx="100" cy="70" rx="85" ry="55" fill="url(#grad1)" />
+           <text fill="#ffffff" font-size="45" font-family="Verdana" x="50" y="86">
+             <a xlink:href="#_at_main2" class="cfg-overlay-closer">Nyaah!</a>
+           </text>
+           Sorry, your browser does not support inline SVG.
+      </svg>
+    )XO"));
+
+    for (auto& renderer: _renderers) {
+      if (auto code = renderer->addJs()) {
+        scripts.push_back(script(*code));
+      }
+    }
+
+    if (!externalAssets() && _gzip_assets)
+      scripts.push_back(emitAssetLoader(scripts));
+
+    return scripts;
+  }
+
+  /// Renders all functions with a body, in parallel if requested.
+  /// The output is always in module order and identical to a serial run.
+  void emitFunctions(raw_ostream& OS) {
+    if (!isParallel()) {
+      forEachFunction([&](FunctionPrinter& printer, Function& fn, size_t) {
+        return printer.emitFunction(fn, OS, indent(CONTENT_INDENT));
+      });
+      return;
+    }
+
+    struct Fragment {
+      std::string html;
+      bool done = false;
+    };
+
+    /// Fragments are written in module order, so one slow function holds back all fragments after it.
+    /// Workers never run further ahead of the last fragment written than this,
+    /// so finished fragments do not pile up in memory while they wait.
+    const size_t max_ahead = 2 * _num_threads;
+
+    std::vector<Fragment>   fragments(numFunctions());
+    std::mutex              mutex;
+    std::condition_variable fragment_done, fragment_written;
+    size_t                  num_written = 0;     // guarded by mutex
+    bool                    failed      = false; // guarded by mutex, some fragment could not be rendered
+
+    forEachFunction(
+      [&](FunctionPrinter& printer, Function& fn, size_t job) -> Error {
+        {
+          std::unique_lock<std::mutex> lock{mutex};
+          fragment_written.wait(lock, [&]() { return failed || (job < num_written + max_ahead); });
+
+          if (failed)
+            return Error::success();
+        }
+
+        std::string buf;
+        raw_string_ostream FOS{buf};
+
+        Error err = printer.emitFunction(fn, FOS, indent(CONTENT_INDENT));
+        FOS.flush();
+
+        {
+          std::lock_guard<std::mutex> lock{mutex};
+          if (err)
+            failed = true;
+          fragments[job].html = std::move(buf);
+          fragments[job].done = true;
+        }
+        fragment_done.notify_all();
+        fragment_written.notify_all(); // wakes up workers waiting for a fragment that is never written if we failed
+        return err;
+      },
+      /// write fragments in module order as soon as they are done
+      [&]() {
+        for (auto& fragment : fragments) {
+          std::string html;
+          {
+            std::unique_lock<std::mutex> lock{mutex};
+            fragment_done.wait(lock, [&]() { return failed || fragment.done; });
+
+            /// the error is reported once all workers are done
+            if (failed)
+              return;
+
+            html = std::move(fragment.html);
+          }
+          OS << html;
+
+          {
+            std::lock_guard<std::mutex> lock{mutex};
+            num_written++;
+          }
+          fragment_written.notify_all();
+        }
+      }
+    );
+  }
+
+  using FunctionCallback = std::function<Error(FunctionPrinter& printer, Function& fn, size_t job)>;
+
+  /// Calls @p callback for every function with a body, @p job is the index of the function among those.
+  /// When running single threaded all calls happen in module order on the calling thread.
+  /// Otherwise they come from worker threads in no particular order, while @p main_thread runs on the calling thread.
+  /// If @p callback fails no more functions are started, the error is reported & we exit once all threads are done.
+  void forEachFunction(const FunctionCallback& callback, const std::function<void()>& main_thread = nullptr) {
+    TimeTrace::Scope span{"functions"};
+
+    if (!isParallel()) {
+      FunctionPrinter printer{_module, _renderers, _sharded, _selected, _cache.get()};
+      printer.names().setNumericIds(_numeric_ids);
+
+      size_t idx = 0, job = 0;
+      for (auto& fn : _module) {
+        if (!isSelected(fn, idx++))
+          continue;
+
+        exitOnError(callback(printer, fn, job++));
+      }
+
+      if (main_thread)
+        main_thread();
+      return;
+    }
+
+    /// Functions are identified by their position in the module, that way we find them in every copy of the module.
+    std::vector<unsigned> jobs;
+    {
+      unsigned idx = 0;
+      for (auto& fn : _module) {
+        if (isSelected(fn, idx))
+          jobs.push_back(idx);
+        idx++;
+      }
+    }
+
+    std::atomic<size_t> next_job{0};
+
+    /// errors of workers, only reported on this thread once all of them are done
+    std::mutex        error_mutex;
+    Error             error = Error::success();
+    std::atomic<bool> failed{false};
+
+    unsigned num_workers = std::max<size_t>(1, std::min<size_t>(_num_threads, jobs.size()));
+
+    ThreadPool pool{num_workers};
+
+    for (unsigned worker = 0; worker < num_workers; worker++) {
+      pool.async([&, worker]() {
+        /// LLVMContexts are not thread safe, so every worker but the first one renders its own copy of the module.
+        LLVMContext             ctx;
+        std::unique_ptr<Module> copy;
+
+        Module* module = &_module;
+
+        if (worker > 0) {
+          copy   = _loader(ctx);
+          module = copy.get();
+
+          assert(module && "copies are parsed from the same input as the module itself");
+        }
+
+        std::vector<Function*> functions;
+        for (auto& fn : *module)
+          functions.push_back(&fn);
+
+        FunctionPrinter printer{*module, _renderers, _sharded, _selected, _cache.get()};
+        printer.names().setNumericIds(_numeric_ids);
+
+        for (size_t job; !failed && ((job = next_job++) < jobs.size());) {
+          if (auto err = callback(printer, *functions[jobs[job]], job)) {
+            std::lock_guard<std::mutex> lock{error_mutex};
+            error  = joinErrors(std::move(error), std::move(err));
+            failed = true;
+          }
+        }
+      });
+    }
+
+    if (main_thread)
+      main_thread();
+
+    pool.wait();
+
+    exitOnError(std::move(error));
+  }
+
+  bool isParallel() const {
+    return (_num_threads > 1) && _loader && llvm_is_multithreaded();
+  }
+
+  /// Does @p fn, at position @p idx in the module, get rendered?
+  /// Only ask before rendering, lazily loaded functions look like declarations once their body was dropped again.
+  bool isSelected(const Function& fn, size_t idx) const {
+    return !fn.isDeclaration() && (_selected.empty() || _selected[idx]);
+  }
+
+  /// number of functions that get rendered
+  size_t numFunctions() const {
+    size_t num = 0, idx = 0;
+    for (auto& fn : _module)
+      num += isSelected(fn, idx++);
+    return num;
+  }
+
+  /// rough size of an instruction in memory, for estimating how much memory function bodies take up
+  static constexpr const size_t IR_BYTES_PER_INSTRUCTION() { return 128; }
+
+  Module&      _module;
+  ModuleLoader _loader;
+  unsigned     _num_threads;
+  bool         _sharded = false; // one page per function
+  bool         _serving = false; // functions are loaded into the page on demand, see runServer()
+
+  std::vector<bool>        _selected; // empty if all functions get rendered
+  std::vector<std::string> _columns;  // empty if all columns get rendered
+  bool                     _numeric_ids = false;
+  bool                     _compress    = false;
+  bool                     _gzip_assets = false;
+  bool                     _compact     = false;
+  std::string              _asset_dir;   // empty unless assets are shared, see setAssetDirectory()
+  StringMap<std::string>   _asset_files; // content hashed file names of assets in _asset_dir
+  StringMap<std::string>   _asset_urls;  // URLs of assets in _asset_dir
+  std::unique_ptr<SourceIndex> _sources; // null unless source code is shown
+
+  std::string                  _config; // see initConfig()
+  std::string                  _cache_dir;
+  std::unique_ptr<RenderCache> _cache;
+
+  HtmlArena _doc_arena;
+
+  std::vector<std::unique_ptr<Renderer>> _renderers;
+};
+
+/// Renders the module in @p input as configured on the command line.
+/// Returns false if the module could not be parsed.
+/// @param shards  state of the output directory for incremental updates, see HtmlPrinter::runSharded()
+static bool renderModule(const char* argv0, MemoryBufferRef input, HtmlPrinter::ShardHashes* shards = nullptr) {
+  /// Bitcode is loaded lazily, function bodies are only materialized when they are rendered.
+  /// All copies of the module are parsed from the same buffer, so they agree even if the input file changes meanwhile.
+  auto loadModule = [=](LLVMContext& ctx) {
+    TimeTrace::Scope span{"parse"};
+
+    SMDiagnostic Err;
+    auto M = getLazyIRModule(MemoryBuffer::getMemBuffer(input), Err, ctx);
+    if (!M)
+      Err.print(argv0, errs());
+    return M;
+  };
+
+  LLVMContext Context;
+
+  std::unique_ptr<Module> M = loadModule(Context);
+  if (!M)
+    return false;
+
+#if 0
+  ModuleSlotTracker slots{&*M};
+  InstructionNamer namer{slots};
+
+  for (auto& fn : *M) {
+    if (fn.isDeclaration())
+      continue;
+
+    DominatorTree domTree{fn};
+    LoopInfo loops{domTree};
+
+    outs() << "// " << fn.getName() << "\n";
+    outs() << "\n";
+    cfg2dot(outs(), fn, namer, loops);
     outs() << "\n";
   }
 #else
-  HtmlPrinter printer{*M};
+  unsigned num_threads = NumThreads ? unsigned(NumThreads) : std::max(1u, std::thread::hardware_concurrency());
+
+  HtmlPrinter printer{*M, loadModule, num_threads};
+
+  FunctionSelection selection;
+  selection.name_regex       = SelectName;
+  selection.name_glob        = SelectGlob;
+  selection.demangled_regex  = SelectDemangled;
+  selection.min_instructions = SelectMinInstructions;
+  selection.min_loop_depth   = SelectMinLoopDepth;
+  selection.call_graph_root  = SelectAround;
+  selection.call_graph_hops  = SelectHops;
+
+  printer.setColumns(Columns);
+  printer.setNumericIds(NumericIds);
+  printer.setShowSource(ShowSource);
+  printer.setCompress(Compress);
+  printer.setGzipAssets(GzipAssets);
+  printer.setCompact(Compact);
+
+  if (!AssetDirectory.empty())
+    printer.setAssetDirectory(AssetDirectory, AssetUrl.empty() ? AssetDirectory : AssetUrl);
+
+  if (!CacheDirectory.empty())
+    printer.setCacheDirectory(CacheDirectory);
+
+  if (!selection.empty()) {
+    TimeTrace::Scope span{"select"};
+
+    if (selection.needsFunctionBodies() && M->getMaterializer()) {
+      /// Selecting has to look at function bodies. Do that on a separate lazily loaded copy of the module,
+      /// which drops every body again right after looking at it, so we still only materialize what we render.
+      LLVMContext ctx;
+      printer.setSelection(selectFunctions(*loadModule(ctx), selection));
+    } else {
+      printer.setSelection(selectFunctions(*M, selection));
+    }
+  }
 
   // Open the output file.
 
-  if (OutputFilename.empty() || (OutputFilename == "-")) {
-    printer.run(outs());
+  if (!ServeAddress.empty()) {
+    printer.runServer(ServeAddress, size_t(ServeCacheSize) << 20);
+  } else if (!OutputDirectory.empty()) {
+    printer.runSharded(OutputDirectory, shards);
   } else {
+    bool compress = Compress || StringRef{OutputFilename}.endswith(".gz");
+
+    /// the page is compressed while it is rendered, by as many threads as are rendering
+    auto run = [&](raw_ostream& OS) {
+      if (compress) {
+        GzipStream GZ{OS, num_threads};
+        printer.run(GZ);
+      } else {
+        printer.run(OS);
+      }
+    };
+
+    if (OutputFilename.empty() || (OutputFilename == "-")) {
+      run(outs());
+    } else {
+      std::error_code EC;
+      tool_output_file TOF{OutputFilename, EC, compress ? sys::fs::F_None : sys::fs::F_Text};
+
+      if (EC) {
+        errs() << argv0 << ": Could not open output file `" << OutputFilename << "': " << EC.message() << '\n';
+        exit(1);
+      }
+
+      run(TOF.os());
+      TOF.keep();
+    }
+  }
+#endif
+
+  return true;
+}
+
+/// Writes what -time-trace & -time-report ask for, everything recorded since llvm-viz started (or the last update with -watch).
+static void writeTimeTrace(const char* argv0) {
+  if (TimeReport)
+    TimeTrace::printReport(errs());
+
+  if (!TimeTraceFile.empty()) {
     std::error_code EC;
-    tool_output_file TOF{OutputFilename, EC, sys::fs::F_Text};
+    raw_fd_ostream OS{TimeTraceFile, EC, sys::fs::F_Text};
 
     if (EC) {
-      errs() << argv[0] << ": Could not open output file `" << OutputFilename << "': " << EC.message() << '\n';
+      errs() << argv0 << ": Could not open time trace file `" << TimeTraceFile << "': " << EC.message() << '\n';
       exit(1);
     }
 
-    printer.run(TOF.os());
-    TOF.keep();
+    TimeTrace::writeChromeTrace(OS);
   }
-#endif
+}
+
+int main(int argc, const char * const* argv) {
+  sys::PrintStackTraceOnErrorSignal(argv[0]);
+  PrettyStackTraceProgram X{argc, argv};
+
+  cl::ParseCommandLineOptions(argc, argv, "LLVM-IR HTML visualizer\n");
+
+  if (!OutputDirectory.empty() && !OutputFilename.empty()) {
+    errs() << argv[0] << ": -o and -o-dir can not be used together\n";
+    exit(1);
+  }
+  if (!ServeAddress.empty() && (!OutputDirectory.empty() || !OutputFilename.empty() || Watch)) {
+    errs() << argv[0] << ": -serve can not be used together with -o, -o-dir or -watch\n";
+    exit(1);
+  }
+  if (!ServeAddress.empty() && !AssetDirectory.empty()) {
+    errs() << argv[0] << ": -serve can not be used together with -asset-dir\n";
+    exit(1);
+  }
+  if (!ServeAddress.empty() && (!TimeTraceFile.empty() || TimeReport)) {
+    errs() << argv[0] << ": -serve can not be used together with -time-trace or -time-report\n";
+    exit(1);
+  }
+  if (!AssetUrl.empty() && AssetDirectory.empty()) {
+    errs() << argv[0] << ": -asset-url needs -asset-dir\n";
+    exit(1);
+  }
+  if (Watch && (OutputDirectory.empty() || (InputFilename == "-"))) {
+    errs() << argv[0] << ": -watch needs an input file and -o-dir\n";
+    exit(1);
+  }
+  if ((Compress || StringRef{OutputFilename}.endswith(".gz")) && !zlib::isAvailable()) {
+    errs() << argv[0] << ": Can not compress output, llvm-viz was built without zlib\n";
+    exit(1);
+  }
+  if (GzipAssets && !zlib::isAvailable()) {
+    errs() << argv[0] << ": Can not compress assets for -gzip-assets, llvm-viz was built without zlib\n";
+    exit(1);
+  }
+  for (auto& column : Columns) {
+    auto known = HtmlPrinter::columnNames();
+
+    if (!is_contained(known, column)) {
+      errs() << argv[0] << ": Unknown column `" << column << "', expected one of:";
+      for (auto& name : known)
+        errs() << ' ' << name;
+      errs() << '\n';
+      exit(1);
+    }
+  }
+
+  if (!TimeTraceFile.empty() || TimeReport)
+    TimeTrace::enable(TimeTraceGranularity);
+
+  // Load IR of the module to be compiled...
+  auto readInput = [&]() -> std::unique_ptr<MemoryBuffer> {
+    TimeTrace::Scope span{"read input"};
+
+    /// Copies of the module and lazily loaded function bodies are parsed from this buffer long after it was read.
+    /// Never memory map the file, a compiler rewriting it in place meanwhile must not change what they see.
+    auto buf = (InputFilename == "-") ? MemoryBuffer::getSTDIN()
+                                      : MemoryBuffer::getFile(InputFilename, -1, true, /*IsVolatile=*/true);
+    if (!buf) {
+      errs() << argv[0] << ": Could not open input file `" << InputFilename << "': " << buf.getError().message() << '\n';
+      return nullptr;
+    }
+    return std::move(*buf);
+  };
+
+  if (!Watch) {
+    auto input = readInput();
+
+    if (!input || !renderModule(argv[0], input->getMemBufferRef()))
+      exit(1);
+
+    writeTimeTrace(argv[0]);
+    return 0;
+  }
+
+  /// Keep running and update the output whenever the input changes.
+  /// Errors are reported, but we just wait for the next change then.
+  FileWatcher              watcher{InputFilename};
+  HtmlPrinter::ShardHashes shards;
 
-  return 0;
+  for (;;) {
+    /// the trace & report of every update only cover that update
+    TimeTrace::reset();
+
+    if (auto input = readInput())
+      renderModule(argv[0], input->getMemBufferRef(), &shards);
+
+    writeTimeTrace(argv[0]);
+
+    errs() << argv[0] << ": Watching `" << InputFilename << "' for changes\n";
+    watcher.wait();
+  }
 }
 
 /// **************************************
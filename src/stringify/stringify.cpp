@@ -4,11 +4,14 @@
 
 // helper program that turns files into C++ string literals
 
-#include <cstdio>
 #include <string>
 #include <llvm/ADT/SmallString.h>
 #include <llvm/Support/CommandLine.h>
+#include <llvm/Support/Compression.h>
+#include <llvm/Support/Error.h>
 #include <llvm/Support/FileSystem.h>
+#include <llvm/Support/MemoryBuffer.h>
+#include <llvm/Support/Path.h>
 #include <llvm/Support/raw_ostream.h>
 #include <llvm/Support/Signals.h>
 #include <llvm/Support/PrettyStackTrace.h>
@@ -17,6 +20,13 @@
 using namespace llvm;
 
 struct Stringify {
+  /// How the data ends up in the binary
+  enum Format {
+    LITERAL, // string literal, one line of input per line
+    ARRAY,   // byte array
+    INCBIN,  // assembler `.incbin' directive, the compiler never sees the data (GNU assemblers & ELF only)
+  };
+
   struct OutputFile final {
     OutputFile(StringRef suffix, StringRef dst) {
       int fd;
@@ -79,6 +89,17 @@ struct Stringify {
                              cl::desc("Name of cpp file to generate"),
                              cl::value_desc("CPP"));
 
+    cl::opt<Format> OutputFormat("format",
+                                 cl::desc("How to embed the data (default: literal)"),
+                                 cl::values(
+                                   clEnumValN(LITERAL, "literal", "C++ string literal"),
+                                   clEnumValN(ARRAY,   "array",   "constexpr byte array"),
+                                   clEnumValN(INCBIN,  "incbin",  "assembler .incbin directive, for large files")
+                                 ),
+                                 cl::init(LITERAL));
+
+    cl::opt<bool> Compress("compress",
+                           cl::desc("Embed the data zlib compressed, it is inflated when first used"));
 
     cl::ParseCommandLineOptions(argc, argv, "convert text to C++ string literal\n");
 
@@ -91,16 +112,30 @@ struct Stringify {
       if (!isValidVarnameChar(c))
         error("Invalid character '" + Twine{c} + "' in variable name.");
 
-    OutputFile HppTmp{"hpp", Hpp};
-    OutputFile CppTmp{"cpp", Cpp};
+    if (Compress && (OutputFormat == INCBIN))
+      error("-compress can not be used together with -format=incbin");
+    if (Compress && !zlib::isAvailable())
+      error("-compress needs zlib, but LLVM was built without it");
+
+    auto input = MemoryBuffer::getFile(Input, -1, false);
+
+    if (!input)
+      error("Could not open input file `" + Input + "': " + input.getError().message());
+
+    StringRef data = (*input)->getBuffer();
 
-    FILE* input = fopen(Input.c_str(), "r");
+    /// compressed data is always embedded as an array, it is binary
+    SmallVector<char, 0> compressed;
+    if (Compress) {
+      if (auto err = zlib::compress(data, compressed, zlib::BestSizeCompression))
+        error("Could not compress input file: " + toString(std::move(err)));
 
-    if (!input) {
-      std::error_code err{errno, std::system_category()};
-      error("Could not open input file `" + Input + "': " + err.message());
+      OutputFormat = ARRAY;
     }
 
+    OutputFile HppTmp{"hpp", Hpp};
+    OutputFile CppTmp{"cpp", Cpp};
+
     /// ***** EMIT HEADER
     {
       auto& OS = HppTmp.os();
@@ -117,9 +152,12 @@ struct Stringify {
       << "\n"
       << "using namespace llvm;\n"
       << "\n"
-      << "/// Returns " << Description << "as a string.\n"
+      << "/// Returns " << Description << " as a string.\n"
       << "extern StringRef " << Name << "();\n"
       << "\n"
+      << "/// Returns " << Description << " as a gzip file.\n"
+      << "extern StringRef " << Name << "Gzip();\n"
+      << "\n"
       << "} // end namespace html\n"
       << "\n";
       OS.flush();
@@ -134,27 +172,93 @@ struct Stringify {
       << "//\n"
       << "\n"
       << "#include \"" << Hpp << "\"\n"
+      << "#include <support/EmbeddedData.hpp>\n"
       << "\n"
       << "using namespace html;\n"
       << "using namespace llvm;\n"
-      << "\n"
-      << "llvm::StringRef html::" << Name << "() {\n"
-      << "  static const char src[] =\n";
-
-      SmallString<256> line;
-      while (getline(line, input)) {
-        OS << "    \"";
-
-        for (char c : line)
-          escape(c, OS);
-
-        OS << "\"\n";
+      << "\n";
 
-        line.clear();
+      switch (OutputFormat) {
+        case LITERAL: {
+          OS << "static const char src[] =\n";
+
+          for (StringRef rest = data; !rest.empty();) {
+            size_t eol = rest.find('\n');
+            StringRef line = rest.substr(0, (eol == StringRef::npos) ? eol : eol + 1);
+            rest = rest.drop_front(line.size());
+
+            OS << "  \"";
+            for (char c : line)
+              escape(c, OS);
+            OS << "\"\n";
+          }
+
+          OS << ";\n"
+             << "\n"
+             << "static const EmbeddedData data{StringRef{src, sizeof(src) - 1}, false, sizeof(src) - 1, 0};\n";
+          break;
+        }
+        case ARRAY: {
+          StringRef bytes = Compress ? StringRef{compressed.data(), compressed.size()} : data;
+
+          OS << "static constexpr const unsigned char src[] = {";
+          for (size_t i = 0; i < bytes.size(); i++) {
+            if (i % 24 == 0)
+              OS << "\n ";
+            OS << ' ' << unsigned(static_cast<unsigned char>(bytes[i])) << ',';
+          }
+          OS << "\n"
+             << "};\n"
+             << "\n"
+             << "static const EmbeddedData data{\n"
+             << "  StringRef{reinterpret_cast<const char*>(src), sizeof(src)},\n"
+             << "  " << (Compress ? "true" : "false") << ",\n"
+             << "  " << data.size() << ",\n"
+             << "  " << (Compress ? zlib::crc32(data) : 0) << "u,\n"
+             << "};\n";
+          break;
+        }
+        case INCBIN: {
+          SmallString<128> path{Input};
+          if (auto err = sys::fs::make_absolute(path))
+            error("Could not find input file `" + Input + "': " + err.message());
+
+          OS << "/// the assembler reads the file, so the compiler does not have to parse it as a huge literal\n"
+             << "asm(\n"
+             << "  \".section .rodata\\n\"\n"
+             << "  \".globl " << Name << "_begin, " << Name << "_end\\n\"\n"
+             << "  \".hidden " << Name << "_begin, " << Name << "_end\\n\"\n"
+             << "  \"" << Name << "_begin:\\n\"\n"
+             << "  \".incbin \\\"";
+          for (char c : path)
+            escape(c, OS);
+          OS << "\\\"\\n\"\n"
+             << "  \"" << Name << "_end:\\n\"\n"
+             << "  \".previous\\n\"\n"
+             << ");\n"
+             << "\n"
+             << "extern \"C\" const char " << Name << "_begin[];\n"
+             << "extern \"C\" const char " << Name << "_end[];\n"
+             << "\n"
+             << "static const size_t size = " << Name << "_end - " << Name << "_begin;\n"
+             << "static const EmbeddedData data{StringRef{" << Name << "_begin, size}, false, size, 0};\n";
+          break;
+        }
       }
 
-      OS << "  ;\n"
-         << "  return src;\n"
+      OS << "\n"
+         << "llvm::StringRef html::" << Name << "() {\n";
+      if (Compress) {
+        OS << "  static const std::string str = data.str();\n"
+           << "  return str;\n";
+      } else {
+        OS << "  return data.bytes;\n";
+      }
+      OS << "}\n"
+         << "\n"
+         << "llvm::StringRef html::" << Name << "Gzip() {\n"
+         << "  static const std::string gz = data.gzip();\n"
+         << "  return gz;\n"
          << "}\n"
          << "\n";
 
@@ -171,30 +275,6 @@ struct Stringify {
       error("Empty string passed to option `-" + opt.ArgStr + "'");
   }
 
-  static bool getline(SmallString<256>&dst, FILE* file) {
-    char buf[256];
-
-    while (true) {
-      auto ret = ::fgets(buf, sizeof(buf), file);
-
-      if (ret) {
-        StringRef str = buf;
-        dst.append(str);
-
-        if (str.back() == '\n')
-          return true;
-      } else {
-        if (feof(file)) {
-          dst.append(buf);
-          return false;
-        } else {
-          std::error_code err{ferror(file), std::system_category()};
-          error("Could not read input file: " + err.message());
-        }
-      }
-    }
-  }
-
   static bool isBetween(char c, char lo, char hi) {
     return (c >= lo) && (c <= hi);
   }
@@ -0,0 +1,40 @@
+// This file is distributed under the Revised BSD Open Source License.
+// See LICENSE.TXT for details.
+
+#include "EmbeddedData.hpp"
+#include "GzipStream.hpp"
+#include <llvm/ADT/SmallVector.h>
+#include <llvm/Support/Compression.h>
+#include <llvm/Support/Error.h>
+#include <llvm/Support/raw_ostream.h>
+
+using namespace llvm;
+
+std::string EmbeddedData::str() const {
+  if (!compressed)
+    return bytes.str();
+
+  SmallVector<char, 0> inflated;
+  if (auto err = zlib::uncompress(bytes, inflated, size)) {
+    logAllUnhandledErrors(std::move(err), errs(), "llvm-viz: Could not inflate embedded data: ");
+    exit(1);
+  }
+  return std::string(inflated.begin(), inflated.end());
+}
+
+std::string EmbeddedData::gzip() const {
+  std::string gz;
+
+  if (compressed) {
+    /// the deflate stream is reused as is, only the framing differs
+    GzipStream::appendMember(gz, bytes, crc, size);
+  } else {
+    raw_string_ostream OS{gz};
+    {
+      GzipStream GZ{OS};
+      GZ << bytes;
+    }
+    OS.flush();
+  }
+  return gz;
+}
@@ -0,0 +1,26 @@
+// This file is distributed under the Revised BSD Open Source License.
+// See LICENSE.TXT for details.
+
+#pragma once
+
+#include <llvm/ADT/StringRef.h>
+#include <cstdint>
+#include <string>
+
+/***
+ * Data stringify embedded into the binary, see src/stringify.
+ *
+ * The data may be stored zlib compressed, then it is only inflated when it is used.
+ */
+struct EmbeddedData {
+  llvm::StringRef bytes;      // the data, or the zlib stream it is compressed to
+  bool            compressed;
+  size_t          size;       // size of the data once inflated
+  uint32_t        crc;        // CRC-32 of the data once inflated, only set if compressed
+
+  /// The data itself.
+  std::string str() const;
+
+  /// The data as a gzip file, for sending it to something that inflates it itself, like a browser.
+  std::string gzip() const;
+};
@@ -0,0 +1,122 @@
+// This file is distributed under the Revised BSD Open Source License.
+// See LICENSE.TXT for details.
+
+#include "GzipStream.hpp"
+#include "TimeTrace.hpp"
+#include <llvm/ADT/StringRef.h>
+#include <llvm/Support/Compression.h>
+#include <llvm/Support/Error.h>
+
+using namespace llvm;
+
+/// header of a gzip member without file name, time stamp or other optional fields
+static const char GZIP_HEADER[] = {
+  '\x1f', '\x8b', // magic
+  8,              // compression method: deflate
+  0,              // flags: none
+  0, 0, 0, 0,     // modification time: unknown, so output does not depend on when it was written
+  0,              // extra flags
+  '\xff',         // operating system: unknown
+};
+
+/// zlib streams wrap the deflate data in a 2 byte header & an adler32 checksum, gzip uses its own framing
+static const size_t ZLIB_HEADER_SIZE  = 2;
+static const size_t ZLIB_TRAILER_SIZE = 4;
+
+static void writeLE32(std::string& dst, uint32_t val) {
+  for (unsigned i = 0; i < 4; i++)
+    dst += char((val >> (8 * i)) & 0xff);
+}
+
+GzipStream::GzipStream(raw_ostream& out, unsigned num_threads)
+: _out{out}
+, _max_in_flight{2 * std::max(num_threads, 1u)}
+, _current{new Block}
+{
+  if (num_threads > 1)
+    _pool.reset(new ThreadPool{num_threads});
+}
+
+GzipStream::~GzipStream() {
+  flush();
+
+  /// even empty output has to be a valid gzip file
+  if (!_current->input.empty() || (_empty && _in_flight.empty()))
+    finishBlock();
+
+  while (!_in_flight.empty())
+    writeOldest();
+}
+
+void GzipStream::write_impl(const char* ptr, size_t size) {
+  _pos += size;
+
+  while (size) {
+    size_t n = std::min(size, BLOCK_SIZE - _current->input.size());
+
+    _current->input.append(ptr, ptr + n);
+    ptr  += n;
+    size -= n;
+
+    if (_current->input.size() == BLOCK_SIZE)
+      finishBlock();
+  }
+}
+
+void GzipStream::finishBlock() {
+  /// bound the memory used by blocks that are compressed but not written yet
+  while (_in_flight.size() >= _max_in_flight)
+    writeOldest();
+
+  Block* block = _current.get();
+
+  if (_pool)
+    block->done = _pool->async([block]() { compress(*block); });
+  else
+    compress(*block);
+
+  _in_flight.push_back(std::move(_current));
+  _current.reset(new Block);
+}
+
+void GzipStream::writeOldest() {
+  auto& block = _in_flight.front();
+
+  if (block->done.valid())
+    block->done.wait();
+
+  _out << block->output;
+  _empty = false;
+
+  _in_flight.pop_front();
+}
+
+void GzipStream::appendMember(std::string& dst, StringRef zlib, uint32_t crc, size_t size) {
+  assert(zlib.size() >= ZLIB_HEADER_SIZE + ZLIB_TRAILER_SIZE);
+
+  StringRef deflated = zlib.drop_front(ZLIB_HEADER_SIZE).drop_back(ZLIB_TRAILER_SIZE);
+
+  dst.reserve(dst.size() + sizeof(GZIP_HEADER) + deflated.size() + 8);
+
+  dst.append(GZIP_HEADER, sizeof(GZIP_HEADER));
+  dst.append(deflated.begin(), deflated.end());
+  writeLE32(dst, crc);
+  writeLE32(dst, uint32_t(size));
+}
+
+void GzipStream::compress(Block& block) {
+  TimeTrace::Scope span{"compress"};
+
+  StringRef input{block.input.data(), block.input.size()};
+
+  SmallVector<char, 0> deflated;
+  if (auto err = zlib::compress(input, deflated, zlib::DefaultCompression)) {
+    logAllUnhandledErrors(std::move(err), errs(), "llvm-viz: Could not compress output: ");
+    exit(1);
+  }
+
+  appendMember(block.output, StringRef{deflated.data(), deflated.size()}, zlib::crc32(input), input.size());
+
+  /// the input is not needed anymore, free it right away
+  block.input = SmallVector<char, 0>{};
+}
@@ -0,0 +1,66 @@
+// This file is distributed under the Revised BSD Open Source License.
+// See LICENSE.TXT for details.
+
+#pragma once
+
+#include <llvm/ADT/SmallVector.h>
+#include <llvm/ADT/StringRef.h>
+#include <llvm/Support/ThreadPool.h>
+#include <llvm/Support/raw_ostream.h>
+#include <deque>
+#include <future>
+#include <memory>
+#include <string>
+
+/***
+ * Stream that gzip compresses everything written to it and passes it on to another stream.
+ *
+ * Output is cut into blocks that are compressed independently, each into a gzip member of its own
+ * (like `bgzip' or `pigz -i'). A gzip file may consist of any number of members, gunzip & co. just concatenate them.
+ * With more than one thread blocks are compressed in parallel while more output is produced,
+ * the compressed blocks are still written in order.
+ *
+ * Everything is compressed & written once the stream is destroyed.
+ */
+struct GzipStream final : llvm::raw_ostream {
+  /// input is compressed in blocks of this many bytes
+  static constexpr const size_t BLOCK_SIZE = 1 << 20;
+
+  /// @param out          where the compressed data goes, has to outlive this stream
+  /// @param num_threads  number of threads compressing blocks, 0 or 1 compresses right on the writing thread
+  explicit GzipStream(llvm::raw_ostream& out, unsigned num_threads = 1);
+  ~GzipStream() override;
+
+  GzipStream(const GzipStream&) = delete;
+  GzipStream& operator=(const GzipStream&) = delete;
+
+  /// Appends a gzip member to @p dst with the data compressed in zlib stream @p zlib (see llvm::zlib::compress()).
+  /// @param crc   CRC-32 of the uncompressed data
+  /// @param size  size of the uncompressed data
+  static void appendMember(std::string& dst, llvm::StringRef zlib, uint32_t crc, size_t size);
+private:
+  struct Block {
+    llvm::SmallVector<char, 0> input;
+    std::string                output; // a complete gzip member
+    std::shared_future<void>   done;   // only valid if the block is compressed on the pool
+  };
+
+  void write_impl(const char* ptr, size_t size) override;
+  uint64_t current_pos() const override { return _pos; }
+
+  /// Hands the current block off for compression.
+  void finishBlock();
+
+  /// Waits for the oldest block in flight and writes it to _out.
+  void writeOldest();
+
+  static void compress(Block& block);
+
+  llvm::raw_ostream&                  _out;
+  std::unique_ptr<llvm::ThreadPool>   _pool; // null if compressing on the writing thread
+  size_t                              _max_in_flight;
+  std::unique_ptr<Block>              _current;
+  std::deque<std::unique_ptr<Block>>  _in_flight;
+  bool                                _empty = true; // nothing was written to _out yet
+  uint64_t                            _pos   = 0;
+};
@@ -0,0 +1,67 @@
+// This file is distributed under the Revised BSD Open Source License.
+// See LICENSE.TXT for details.
+
+#pragma once
+
+#include <llvm/ADT/StringMap.h>
+#include <llvm/ADT/StringRef.h>
+#include <list>
+#include <string>
+#include <utility>
+
+/// Cache from strings to strings that evicts the least recently used entries
+/// once the cached values take up more than a given number of bytes.
+struct LruCache {
+  explicit LruCache(size_t max_bytes) : _max_bytes{max_bytes} {}
+
+  /// Returns the value cached for @p key and marks it as most recently used, or nullptr if there is none.
+  /// The pointer stays valid until the next call to insert().
+  const std::string* lookup(llvm::StringRef key) {
+    auto it = _index.find(key);
+    if (it == _index.end())
+      return nullptr;
+
+    _entries.splice(_entries.begin(), _entries, it->second);
+    return &it->second->second;
+  }
+
+  /// Caches @p value for @p key, evicting the least recently used entries until everything fits again.
+  /// Values larger than the whole cache are not cached at all.
+  void insert(llvm::StringRef key, std::string value) {
+    erase(key);
+
+    if (value.size() > _max_bytes)
+      return;
+
+    _bytes += value.size();
+    _entries.emplace_front(key.str(), std::move(value));
+    _index[key] = _entries.begin();
+
+    while (_bytes > _max_bytes)
+      erase(_entries.back().first);
+  }
+
+  /// number of bytes taken up by cached values
+  size_t size() const {
+    return _bytes;
+  }
+private:
+  using Entry = std::pair<std::string, std::string>;
+
+  void erase(llvm::StringRef key) {
+    auto it = _index.find(key);
+    if (it == _index.end())
+      return;
+
+    auto entry = it->second;
+
+    _bytes -= entry->second.size();
+    _index.erase(it);
+    _entries.erase(entry);
+  }
+
+  std::list<Entry>                             _entries; // most recently used first
+  llvm::StringMap<std::list<Entry>::iterator> _index;
+  size_t                                       _max_bytes;
+  size_t                                       _bytes = 0;
+};
@@ -0,0 +1,267 @@
+// This file is distributed under the Revised BSD Open Source License.
+// See LICENSE.TXT for details.
+
+#include "TimeTrace.hpp"
+#include <llvm/ADT/STLExtras.h>
+#include <llvm/ADT/StringMap.h>
+#include <llvm/Support/Format.h>
+#include <algorithm>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+using namespace llvm;
+
+bool TimeTrace::_enabled = false;
+
+namespace {
+
+/// one finished span
+struct Event {
+  std::string name, detail;
+  uint64_t    start;    // in microseconds since recording started
+  uint64_t    duration; // in microseconds
+};
+
+/// everything spans of any name add up to
+struct Total {
+  uint64_t count    = 0;
+  uint64_t duration = 0; // in microseconds
+};
+
+/// number of spans with a detail listed in the report
+constexpr const size_t NUM_SLOWEST() { return 10; }
+
+/// Adds @p event to @p slowest if it is one of the NUM_SLOWEST() slowest, keeps @p slowest sorted slowest first.
+void addSlowest(std::vector<Event>& slowest, const Event& event) {
+  if ((slowest.size() >= NUM_SLOWEST()) && (slowest.back().duration >= event.duration))
+    return;
+
+  auto pos = std::upper_bound(slowest.begin(), slowest.end(), event, [](const Event& a, const Event& b) {
+    return a.duration > b.duration;
+  });
+  slowest.insert(pos, event);
+
+  if (slowest.size() > NUM_SLOWEST())
+    slowest.pop_back();
+}
+
+/***
+ * Everything one thread recorded.
+ *
+ * Every thread records into a buffer of its own, so threads recording spans do not wait for each other.
+ * The lock is only ever contended while the trace is written or reset.
+ * Buffers outlive their threads, a buffer whose thread is gone is reused by the next new thread.
+ */
+struct ThreadBuffer {
+  explicit ThreadBuffer(unsigned thread) : thread{thread} {}
+
+  std::mutex         mutex;   // guards everything below
+  const unsigned     thread;  // identifies the buffer in the trace
+  bool               in_use = true;
+  std::vector<Event> events;  // spans in the trace
+  StringMap<Total>   totals;  // by name
+  std::vector<Event> slowest; // the slowest spans with a detail, slowest first
+};
+
+std::mutex                                 buffers_mutex; // guards buffers & started
+std::vector<std::unique_ptr<ThreadBuffer>> buffers;
+TimeTrace::Clock::time_point               started;       // also guarded by the lock of every buffer, see reset()
+unsigned                                   granularity;
+
+/// Hands a buffer to a thread on first use & releases it again when the thread exits.
+struct BufferHandle {
+  BufferHandle() {
+    std::lock_guard<std::mutex> lock{buffers_mutex};
+
+    auto it = find_if(buffers, [](const std::unique_ptr<ThreadBuffer>& buffer) { return !buffer->in_use; });
+
+    if (it != buffers.end()) {
+      buffer = it->get();
+      buffer->in_use = true;
+    } else {
+      buffers.emplace_back(new ThreadBuffer{unsigned(buffers.size())});
+      buffer = buffers.back().get();
+    }
+  }
+
+  ~BufferHandle() {
+    std::lock_guard<std::mutex> lock{buffers_mutex};
+    buffer->in_use = false;
+  }
+
+  ThreadBuffer* buffer;
+};
+
+ThreadBuffer& threadBuffer() {
+  thread_local BufferHandle handle;
+  return *handle.buffer;
+}
+
+uint64_t microseconds(TimeTrace::Clock::duration d) {
+  return uint64_t(std::chrono::duration_cast<std::chrono::microseconds>(d).count());
+}
+
+void printJsonString(raw_ostream& OS, StringRef str) {
+  OS << '"';
+  for (char c : str) {
+    switch (c) {
+      case '"':  OS << "\\\""; break;
+      case '\\': OS << "\\\\"; break;
+      case '\n': OS << "\\n";  break;
+      case '\t': OS << "\\t";  break;
+      default:
+        if (uint8_t(c) < 0x20)
+          OS << format("\\u%04x", unsigned(c));
+        else
+          OS << c;
+    }
+  }
+  OS << '"';
+}
+
+} // end anonymous namespace
+
+void TimeTrace::enable(unsigned granularity_us) {
+  std::lock_guard<std::mutex> lock{buffers_mutex};
+
+  started     = Clock::now();
+  granularity = granularity_us;
+  _enabled    = true;
+}
+
+void TimeTrace::reset() {
+  std::lock_guard<std::mutex> lock{buffers_mutex};
+
+  /// no thread may record a span while the clock is reset, so take all locks at once
+  std::vector<std::unique_lock<std::mutex>> locks;
+  for (auto& buffer : buffers)
+    locks.emplace_back(buffer->mutex);
+
+  started = Clock::now();
+
+  for (auto& buffer : buffers) {
+    buffer->events.clear();
+    buffer->totals.clear();
+    buffer->slowest.clear();
+  }
+}
+
+void TimeTrace::Scope::begin(const Twine& name, const Twine& detail) {
+  _active = true;
+  _name   = name.str();
+  _detail = detail.str();
+  _start  = Clock::now();
+}
+
+void TimeTrace::Scope::end() {
+  auto now = Clock::now();
+
+  ThreadBuffer& buffer = threadBuffer();
+
+  std::lock_guard<std::mutex> lock{buffer.mutex};
+
+  /// spans started before the last reset() are cut off there
+  auto start = std::max(_start, started);
+
+  Event event{std::move(_name), std::move(_detail), microseconds(start - started), microseconds(now - start)};
+
+  Total& total = buffer.totals[event.name];
+  total.count++;
+  total.duration += event.duration;
+
+  if (!event.detail.empty())
+    addSlowest(buffer.slowest, event);
+
+  if (event.duration >= granularity)
+    buffer.events.push_back(std::move(event));
+}
+
+void TimeTrace::writeChromeTrace(raw_ostream& OS) {
+  std::lock_guard<std::mutex> lock{buffers_mutex};
+
+  OS << "{\"traceEvents\":[\n";
+
+  bool first = true;
+  for (auto& buffer : buffers) {
+    std::lock_guard<std::mutex> buffer_lock{buffer->mutex};
+
+    for (auto& event : buffer->events) {
+      if (!first)
+        OS << ",\n";
+      first = false;
+
+      OS << "{\"ph\":\"X\",\"pid\":1,\"tid\":" << buffer->thread
+         << ",\"ts\":" << event.start
+         << ",\"dur\":" << event.duration
+         << ",\"name\":";
+      printJsonString(OS, event.name);
+
+      if (!event.detail.empty()) {
+        OS << ",\"args\":{\"detail\":";
+        printJsonString(OS, event.detail);
+        OS << '}';
+      }
+      OS << '}';
+    }
+  }
+
+  OS << "\n],\"displayTimeUnit\":\"ms\"}\n";
+}
+
+void TimeTrace::printReport(raw_ostream& OS) {
+  std::lock_guard<std::mutex> lock{buffers_mutex};
+
+  double run = microseconds(Clock::now() - started) / 1e6;
+
+  /// sum up what all threads recorded
+  StringMap<Total>   totals;
+  std::vector<Event> slowest;
+
+  for (auto& buffer : buffers) {
+    std::lock_guard<std::mutex> buffer_lock{buffer->mutex};
+
+    for (auto& entry : buffer->totals) {
+      Total& total = totals[entry.getKey()];
+      total.count    += entry.getValue().count;
+      total.duration += entry.getValue().duration;
+    }
+
+    for (auto& event : buffer->slowest)
+      addSlowest(slowest, event);
+  }
+
+  std::vector<const StringMapEntry<Total>*> names;
+  for (auto& entry : totals)
+    names.push_back(&entry);
+
+  std::sort(names.begin(), names.end(), [](const StringMapEntry<Total>* a, const StringMapEntry<Total>* b) {
+    return a->getValue().duration > b->getValue().duration;
+  });
+
+  OS << "===" << std::string(73, '-') << "===\n"
+     << "                          llvm-viz time report\n"
+     << "===" << std::string(73, '-') << "===\n"
+     << "  Total run time: " << format("%.4f", run) << " seconds\n"
+     << "  Spans nest, so time spent in a span also counts for the spans around it.\n"
+     << "  Spans on different threads overlap, so with -j their sum may exceed the run time.\n"
+     << '\n'
+     << "   Time (s)   % of run       Count  Name\n";
+
+  for (auto entry : names) {
+    auto& total = entry->getValue();
+    double secs = total.duration / 1e6;
+
+    OS << format("  %9.4f  %8.1f%%  %10llu  ", secs, run > 0 ? 100 * secs / run : 0.0, (unsigned long long) total.count)
+       << entry->getKey() << '\n';
+  }
+
+  if (!slowest.empty()) {
+    OS << '\n'
+       << "  Slowest spans:\n"
+       << "   Time (s)  Name\n";
+
+    for (auto& event : slowest)
+      OS << format("  %9.4f  ", event.duration / 1e6) << event.name << ' ' << event.detail << '\n';
+  }
+}
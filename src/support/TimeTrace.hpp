@@ -0,0 +1,67 @@
+// This file is distributed under the Revised BSD Open Source License.
+// See LICENSE.TXT for details.
+
+#pragma once
+
+#include <llvm/ADT/Twine.h>
+#include <llvm/Support/raw_ostream.h>
+#include <chrono>
+#include <string>
+
+/***
+ * Records how long the phases of a run take, for finding out where the time goes.
+ *
+ * Code marks phases with a TimeTrace::Scope, scopes may nest and be used on any thread.
+ * Nothing is recorded unless enable() was called, until then a scope costs a check of a flag.
+ *
+ * What was recorded can be written in the Chrome trace event format (see writeChromeTrace()),
+ * which chrome://tracing or https://ui.perfetto.dev show as a timeline per thread,
+ * or summed up per phase in a table (see printReport()).
+ */
+struct TimeTrace {
+  using Clock = std::chrono::steady_clock;
+
+  /// Start recording, everything is timed relative to now.
+  /// @param granularity  spans shorter than this many microseconds are left out of the trace,
+  ///                     they still count for the report
+  static void enable(unsigned granularity = 0);
+
+  static bool enabled() { return _enabled; }
+
+  /// Forget everything recorded so far and time everything relative to now again.
+  /// Spans that are still running when this is called are recorded as if they had started now.
+  static void reset();
+
+  /// Records the time between its construction and destruction.
+  struct Scope {
+    /// @param name    what is done, spans are summed up by name in the report
+    /// @param detail  what it is done to, like the name of a function. Only shown in the trace & for the slowest spans.
+    explicit Scope(const llvm::Twine& name, const llvm::Twine& detail = llvm::Twine{}) {
+      if (enabled())
+        begin(name, detail);
+    }
+
+    ~Scope() {
+      if (_active)
+        end();
+    }
+
+    Scope(const Scope&) = delete;
+    Scope& operator=(const Scope&) = delete;
+  private:
+    void begin(const llvm::Twine& name, const llvm::Twine& detail);
+    void end();
+
+    bool              _active = false;
+    std::string       _name, _detail;
+    Clock::time_point _start;
+  };
+
+  /// Writes everything recorded so far as a JSON trace in the Chrome trace event format.
+  static void writeChromeTrace(llvm::raw_ostream& OS);
+
+  /// Prints the total time spent per name, and the slowest spans that have a detail.
+  static void printReport(llvm::raw_ostream& OS);
+private:
+  static bool _enabled; // only set before any other threads are started
+};